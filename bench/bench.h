@@ -0,0 +1,39 @@
+#ifndef _UPROC_BENCH_H_
+#define _UPROC_BENCH_H_
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+* Helpers shared by the benchmarks, results are printed as one JSON object per line.
+*/
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* a cheap per-thread random number generator, @s must not be 0 */
+static inline uint32_t xorshift(uint32_t *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+/* resident set size of the process in kB, 0 if unknown */
+static inline unsigned long rss_kb(void) {
+    unsigned long size, resident = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+
+    if (!fp)
+        return 0;
+    if (fscanf(fp, "%lu %lu", &size, &resident) != 2)
+        resident = 0;
+    fclose(fp);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+#endif
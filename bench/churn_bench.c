@@ -0,0 +1,318 @@
+/*
+* Stress benchmark of tree mutation: app threads keep registering directories
+* and entries while reader threads hammer the mount.
+* The readers first run alone for a baseline, then along with the app threads.
+* Every second of the churn the size of the tree and the resident memory are reported,
+* then the latencies of both phases and of the registrations, one JSON object per line, e.g.
+*
+*   {"bench":"churn","t":3,"entries":1843200,"rss_kb":612340}
+*   {"bench":"churn","phase":"churn","op":"register","ops":1843200,"ops_per_sec":614400.0,
+*    "p50_ns":1151,"p99_ns":4095,"p999_ns":20479,"max_ns":2301223}
+*
+* There is no removal of entries, so the tree only grows while the app threads run:
+* rss_kb over entries gives the memory cost of an entry.
+*
+* usage: churn_bench [-n entries] [-a app threads] [-j reader threads] [-b batch]
+*                    [-d seconds] [-m mountpoint] [-M]
+*/
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <uproc.h>
+#include <histogram.h>
+
+#include "bench.h"
+
+enum { OP_STAT, OP_READ, OP_READDIR, OP_REGISTER, OP_MAX };
+static const char *op_names[OP_MAX] = { "stat", "read", "readdir", "register" };
+enum { PHASE_BASELINE, PHASE_CHURN, PHASE_MAX };
+static const char *phase_names[PHASE_MAX] = { "baseline", "churn" };
+
+/* one readdir for every READDIR_EVERY file operations */
+#define READDIR_EVERY 16
+#define MAX_APPS      64
+
+typedef struct {
+    int           entries;  // registered before the mount, read by the readers
+    int           apps;
+    int           readers;
+    int           batch;    // entries registered in every new directory
+    int           seconds;  // of each phase
+    const char   *mount_point;
+    int           mt;
+} churn_opts_t;
+
+static uproc_ctx_t    ctx;
+static churn_opts_t   opts = { 10000, 2, 4, 64, 5, "uproc_bench", 0 };
+static uproc_hist_t  *hists[PHASE_MAX][OP_MAX];
+static uint64_t       value;
+static int            phase, stop, stop_apps;
+static uint64_t       registered;
+/* last directory completed by every app thread, -1 before the first one */
+static int            generation[MAX_APPS];
+
+static void oom(void) {
+    fprintf(stderr, "churn_bench: out of memory\n");
+    exit(1);
+}
+
+/* "stable/<n / 64>/v<n>", read all along */
+static void build_stable(int n) {
+    uproc_dentry_t *stable, *dir = NULL;
+    char name[32];
+    int i;
+
+    if (!(stable = uproc_mkdir(&ctx, "stable", NULL)) || !uproc_mkdir(&ctx, "churn", NULL))
+        oom();
+    for (i = 0; i < n; ++i) {
+        snprintf(name, sizeof(name), "%d", i / 64);
+        if (i % 64 == 0 && !(dir = uproc_mkdir(&ctx, name, stable)))
+            oom();
+        snprintf(name, sizeof(name), "v%d", i);
+        if (!uproc_create_entry_uint64(&ctx, name, 0, dir, 1, &value))
+            oom();
+    }
+}
+
+static void* run_thread(void *data) {
+    if (opts.mt)
+        uproc_run_mt(&ctx);
+    else
+        uproc_run(&ctx);
+    return NULL;
+}
+
+/* registers "churn/a<id>/g<generation>/e<i>" until told to stop */
+static void* app_thread(void *data) {
+    int id = (int)(intptr_t)data, gen, i;
+    uproc_dentry_t *app, *dir;
+    uproc_hist_t *h = hists[PHASE_CHURN][OP_REGISTER];
+    uint64_t start;
+    char name[32];
+
+    snprintf(name, sizeof(name), "churn/a%d", id);
+    if (!(app = uproc_mkdir(&ctx, name, NULL)) || uproc_hist_thread_prepare(h))
+        oom();
+    for (gen = 0; !__atomic_load_n(&stop_apps, __ATOMIC_RELAXED); ++gen) {
+        snprintf(name, sizeof(name), "g%d", gen);
+        start = now_ns();
+        if (!(dir = uproc_mkdir(&ctx, name, app)))
+            oom();
+        uproc_hist_record(h, now_ns() - start);
+        for (i = 0; i < opts.batch; ++i) {
+            snprintf(name, sizeof(name), "e%d", i);
+            start = now_ns();
+            if (!uproc_create_entry_uint64(&ctx, name, 0, dir, 1, &value))
+                oom();
+            uproc_hist_record(h, now_ns() - start);
+        }
+        __atomic_fetch_add(&registered, opts.batch + 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&generation[id], gen, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+/* a random stable entry, or with the app threads running, one of the last ones they made */
+static void pick_path(char *path, size_t size, uint32_t *seed, int dir) {
+    uint32_t r = xorshift(seed);
+    int app = r % opts.apps, gen;
+
+    gen = __atomic_load_n(&generation[app], __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&phase, __ATOMIC_RELAXED) == PHASE_CHURN && gen >= 0 && (r >> 16) % 4 == 0) {
+        if (dir)
+            snprintf(path, size, "%s/churn/a%d/g%d", opts.mount_point, app, gen);
+        else
+            snprintf(path, size, "%s/churn/a%d/g%d/e%u", opts.mount_point, app, gen,
+                     (r >> 8) % opts.batch);
+        return;
+    }
+    r = (r >> 4) % opts.entries;
+    if (dir)
+        snprintf(path, size, "%s/stable/%u", opts.mount_point, r / 64);
+    else
+        snprintf(path, size, "%s/stable/%u/v%u", opts.mount_point, r / 64, r);
+}
+
+static void* reader_thread(void *data) {
+    char path[1024], buf[4096];
+    uint32_t seed = (uint32_t)(uintptr_t)data * 2654435761u + 1;
+    unsigned long iter = 0;
+    struct stat st;
+    uint64_t start;
+    int p, fd, dir, i;
+    DIR *d;
+
+    // allocate the shards before timing anything
+    for (p = 0; p < PHASE_MAX; ++p) {
+        for (i = 0; i < OP_MAX; ++i)
+            uproc_hist_thread_prepare(hists[p][i]);
+    }
+    while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+        p = __atomic_load_n(&phase, __ATOMIC_RELAXED);
+        dir = ++iter % READDIR_EVERY == 0;
+        pick_path(path, sizeof(path), &seed, dir);
+        if (dir) {
+            start = now_ns();
+            if ((d = opendir(path))) {
+                while (readdir(d))
+                    ;
+                closedir(d);
+            }
+            uproc_hist_record(hists[p][OP_READDIR], now_ns() - start);
+            continue;
+        }
+
+        start = now_ns();
+        stat(path, &st);
+        uproc_hist_record(hists[p][OP_STAT], now_ns() - start);
+
+        start = now_ns();
+        if ((fd = open(path, O_RDONLY)) >= 0) {
+            while (read(fd, buf, sizeof(buf)) > 0)
+                ;
+            close(fd);
+        }
+        uproc_hist_record(hists[p][OP_READ], now_ns() - start);
+    }
+    return NULL;
+}
+
+static int wait_mounted(int timeout_ms) {
+    char path[1024];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "%s/churn", opts.mount_point);
+    for (; timeout_ms > 0; timeout_ms -= 10) {
+        if (!stat(path, &st))
+            return 0;
+        usleep(10 * 1000);
+    }
+    return -ETIMEDOUT;
+}
+
+static void report(const double *seconds) {
+    uproc_hist_snapshot_t snap;
+    int p, i;
+
+    for (p = 0; p < PHASE_MAX; ++p) {
+        for (i = 0; i < OP_MAX; ++i) {
+            uproc_hist_snapshot(hists[p][i], &snap);
+            if (!snap.count)
+                continue;
+            printf("{\"bench\":\"churn\",\"phase\":\"%s\",\"op\":\"%s\",\"entries\":%d,\"apps\":%d,"
+                   "\"threads\":%d,\"batch\":%d,\"loop\":\"%s\",\"seconds\":%.3f,\"ops\":%llu,"
+                   "\"ops_per_sec\":%.1f,\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu}\n",
+                   phase_names[p], op_names[i], opts.entries, opts.apps, opts.readers, opts.batch,
+                   opts.mt ? "mt" : "st", seconds[p], (unsigned long long)snap.count, snap.count / seconds[p],
+                   (unsigned long long)uproc_hist_percentile(&snap, 0.5),
+                   (unsigned long long)uproc_hist_percentile(&snap, 0.99),
+                   (unsigned long long)uproc_hist_percentile(&snap, 0.999),
+                   (unsigned long long)snap.max);
+        }
+    }
+    fflush(stdout);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: churn_bench [-n entries] [-a app threads] [-j reader threads] [-b batch] "
+                    "[-d seconds] [-m mountpoint] [-M]\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    pthread_t loop, *readers, apps[MAX_APPS];
+    double seconds[PHASE_MAX];
+    struct stat st;
+    uint64_t start;
+    int c, i, p, t;
+
+    while ((c = getopt(argc, argv, "n:a:j:b:d:m:M")) != -1) {
+        switch (c) {
+        case 'n': opts.entries = atoi(optarg); break;
+        case 'a': opts.apps = atoi(optarg); break;
+        case 'j': opts.readers = atoi(optarg); break;
+        case 'b': opts.batch = atoi(optarg); break;
+        case 'd': opts.seconds = atoi(optarg); break;
+        case 'm': opts.mount_point = optarg; break;
+        case 'M': opts.mt = 1; break;
+        default: usage();
+        }
+    }
+    if (opts.entries <= 0 || opts.apps <= 0 || opts.apps > MAX_APPS || opts.readers <= 0 ||
+        opts.batch <= 0 || opts.seconds <= 0)
+        usage();
+
+    if (mkdir(opts.mount_point, 0755) && errno != EEXIST) {
+        fprintf(stderr, "churn_bench: can't create %s: %s\n", opts.mount_point, strerror(errno));
+        return 1;
+    }
+    if (uproc_ctx_init(&ctx, opts.mount_point, 0))
+        oom();
+    build_stable(opts.entries);
+    for (p = 0; p < PHASE_MAX; ++p) {
+        for (i = 0; i < OP_MAX; ++i) {
+            if (!(hists[p][i] = uproc_hist_alloc()))
+                oom();
+        }
+    }
+    for (i = 0; i < MAX_APPS; ++i)
+        generation[i] = -1;
+
+    if (pthread_create(&loop, NULL, run_thread, NULL))
+        return 1;
+    if (wait_mounted(5000)) {
+        fprintf(stderr, "churn_bench: %s did not come up\n", opts.mount_point);
+        return 1;
+    }
+
+    if (!(readers = calloc(opts.readers, sizeof(*readers))))
+        oom();
+    start = now_ns();
+    for (i = 0; i < opts.readers; ++i) {
+        if (pthread_create(&readers[i], NULL, reader_thread, (void*)(uintptr_t)i))
+            return 1;
+    }
+    sleep(opts.seconds);
+
+    __atomic_store_n(&phase, PHASE_CHURN, __ATOMIC_RELAXED);
+    seconds[PHASE_BASELINE] = (now_ns() - start) / 1e9;
+    start = now_ns();
+    for (i = 0; i < opts.apps; ++i) {
+        if (pthread_create(&apps[i], NULL, app_thread, (void*)(intptr_t)i))
+            return 1;
+    }
+    for (t = 1; t <= opts.seconds; ++t) {
+        sleep(1);
+        printf("{\"bench\":\"churn\",\"t\":%d,\"entries\":%llu,\"rss_kb\":%lu}\n", t,
+               (unsigned long long)__atomic_load_n(&registered, __ATOMIC_RELAXED), rss_kb());
+        fflush(stdout);
+    }
+    __atomic_store_n(&stop_apps, 1, __ATOMIC_RELAXED);
+    for (i = 0; i < opts.apps; ++i)
+        pthread_join(apps[i], NULL);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    for (i = 0; i < opts.readers; ++i)
+        pthread_join(readers[i], NULL);
+    seconds[PHASE_CHURN] = (now_ns() - start) / 1e9;
+    report(seconds);
+
+    uproc_exit(&ctx);
+    stat(opts.mount_point, &st);
+    pthread_join(loop, NULL);
+
+    for (p = 0; p < PHASE_MAX; ++p) {
+        for (i = 0; i < OP_MAX; ++i)
+            uproc_hist_free(hists[p][i]);
+    }
+    free(readers);
+    return 0;
+}
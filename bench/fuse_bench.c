@@ -0,0 +1,332 @@
+/*
+* End-to-end benchmark: registers a tree, mounts it and drives it with
+* concurrent readers doing stat, open/read/close and readdir through the kernel.
+* Every operation kind is reported on its own line as a JSON object, e.g.
+*
+*   {"bench":"fuse","tree":"flat","entries":10000,"threads":4,"loop":"st","seconds":5.000,
+*    "op":"read","ops":812345,"ops_per_sec":162469.0,"p50_ns":20479,"p99_ns":57343,"p999_ns":188415,"max_ns":1203401}
+*
+* usage: fuse_bench [-t flat|deep|wide|conn] [-n entries] [-j threads] [-d seconds] [-m mountpoint] [-M]
+*/
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <uproc.h>
+#include <histogram.h>
+
+#include "bench.h"
+
+enum { OP_STAT, OP_READ, OP_READDIR, OP_MAX };
+static const char *op_names[OP_MAX] = { "stat", "read", "readdir" };
+
+/* one readdir for every READDIR_EVERY file operations */
+#define READDIR_EVERY 16
+/* directory depth of the deep tree */
+#define DEEP_LEVELS   16
+/* entries of a connection in the per-connection tree */
+#define CONN_FIELDS   4
+
+typedef struct {
+    const char   *tree;
+    int           entries;
+    int           threads;
+    int           seconds;
+    const char   *mount_point;
+    int           mt;
+} bench_opts_t;
+
+typedef struct {
+    char        **files;    // paths relative to the mount point
+    int           nfiles;
+    char        **dirs;
+    int           ndirs;
+} bench_paths_t;
+
+static uproc_ctx_t    ctx;
+static bench_opts_t   opts = { "flat", 10000, 4, 5, "uproc_bench", 0 };
+static bench_paths_t  paths;
+static uproc_hist_t  *hists[OP_MAX];
+static uint64_t       values[CONN_FIELDS];
+static int            stop;
+
+static void add_path(char ***v, int *n, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+static void add_path(char ***v, int *n, const char *fmt, ...) {
+    char path[1024];
+    va_list ap;
+
+    // the array doubles whenever @n reaches a power of two
+    if (!(*n & (*n - 1)) && !(*v = realloc(*v, (*n ? *n * 2 : 1) * sizeof(char*))))
+        goto nomem;
+    va_start(ap, fmt);
+    vsnprintf(path, sizeof(path), fmt, ap);
+    va_end(ap);
+    if (!((*v)[*n] = strdup(path)))
+        goto nomem;
+    ++*n;
+    return;
+nomem:
+    fprintf(stderr, "fuse_bench: out of memory\n");
+    exit(1);
+}
+
+static void check_entry(void *ent, const char *what) {
+    if (!ent) {
+        fprintf(stderr, "fuse_bench: failed to register %s\n", what);
+        exit(1);
+    }
+}
+
+/* @n entries in the root directory */
+static void build_flat(int n) {
+    char name[32];
+    int i;
+
+    add_path(&paths.dirs, &paths.ndirs, "%s", "");
+    for (i = 0; i < n; ++i) {
+        snprintf(name, sizeof(name), "v%d", i);
+        check_entry(uproc_create_entry_uint64(&ctx, name, 0, NULL, 1, &values[i % CONN_FIELDS]), name);
+        add_path(&paths.files, &paths.nfiles, "%s", name);
+    }
+}
+
+/* a chain of DEEP_LEVELS directories, the entries are spread over the levels */
+static void build_deep(int n) {
+    uproc_dentry_t *dir = NULL;
+    char path[DEEP_LEVELS * 8] = "", name[32];
+    int i, level, len = 0;
+
+    for (level = 0; level < DEEP_LEVELS; ++level) {
+        snprintf(name, sizeof(name), "d%d", level);
+        check_entry(dir = uproc_mkdir(&ctx, name, dir), name);
+        len += snprintf(path + len, sizeof(path) - len, "%s%s", level ? "/" : "", name);
+        add_path(&paths.dirs, &paths.ndirs, "%s", path);
+        for (i = level; i < n; i += DEEP_LEVELS) {
+            snprintf(name, sizeof(name), "v%d", i);
+            check_entry(uproc_create_entry_uint64(&ctx, name, 0, dir, 1, &values[i % CONN_FIELDS]), name);
+            add_path(&paths.files, &paths.nfiles, "%s/%s", path, name);
+        }
+    }
+}
+
+/* sqrt(@n) directories of sqrt(@n) entries */
+static void build_wide(int n) {
+    uproc_dentry_t *dir;
+    char name[32];
+    int i, j, w;
+
+    for (w = 1; w * w < n; ++w)
+        ;
+    for (i = 0; i * w < n; ++i) {
+        snprintf(name, sizeof(name), "d%d", i);
+        check_entry(dir = uproc_mkdir(&ctx, name, NULL), name);
+        add_path(&paths.dirs, &paths.ndirs, "d%d", i);
+        for (j = 0; j < w && i * w + j < n; ++j) {
+            snprintf(name, sizeof(name), "v%d", j);
+            check_entry(uproc_create_entry_uint64(&ctx, name, 0, dir, 1, &values[j % CONN_FIELDS]), name);
+            add_path(&paths.files, &paths.nfiles, "d%d/%s", i, name);
+        }
+    }
+}
+
+/* "conn/<id>/{rx,tx,rtt,state}", the layout of per-connection statistics */
+static void build_conn(int n) {
+    static const char *fields[CONN_FIELDS] = { "rx", "tx", "rtt", "state" };
+    uproc_dentry_t *conn, *dir;
+    char name[32];
+    int i, f;
+
+    check_entry(conn = uproc_mkdir(&ctx, "conn", NULL), "conn");
+    add_path(&paths.dirs, &paths.ndirs, "%s", "conn");
+    for (i = 0; i * CONN_FIELDS < n; ++i) {
+        snprintf(name, sizeof(name), "%d", i);
+        check_entry(dir = uproc_mkdir(&ctx, name, conn), name);
+        add_path(&paths.dirs, &paths.ndirs, "conn/%d", i);
+        for (f = 0; f < CONN_FIELDS; ++f) {
+            check_entry(uproc_create_entry_uint64(&ctx, fields[f], 0, dir, 1, &values[f]), fields[f]);
+            add_path(&paths.files, &paths.nfiles, "conn/%d/%s", i, fields[f]);
+        }
+    }
+}
+
+static int build_tree(const char *tree, int n) {
+    if (!strcmp(tree, "flat"))
+        build_flat(n);
+    else if (!strcmp(tree, "deep"))
+        build_deep(n);
+    else if (!strcmp(tree, "wide"))
+        build_wide(n);
+    else if (!strcmp(tree, "conn"))
+        build_conn(n);
+    else
+        return -EINVAL;
+    return 0;
+}
+
+static void* run_thread(void *data) {
+    if (opts.mt)
+        uproc_run_mt(&ctx);
+    else
+        uproc_run(&ctx);
+    return NULL;
+}
+
+static void* reader_thread(void *data) {
+    char path[1024], buf[4096];
+    uint32_t seed = (uint32_t)(uintptr_t)data * 2654435761u + 1;
+    unsigned long iter = 0;
+    struct dirent *de;
+    struct stat st;
+    uint64_t start;
+    DIR *d;
+    int fd, i;
+
+    // allocate the shards before timing anything
+    for (i = 0; i < OP_MAX; ++i)
+        uproc_hist_thread_prepare(hists[i]);
+    while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+        if (++iter % READDIR_EVERY == 0) {
+            snprintf(path, sizeof(path), "%s/%s", opts.mount_point, paths.dirs[xorshift(&seed) % paths.ndirs]);
+            start = now_ns();
+            if ((d = opendir(path))) {
+                while ((de = readdir(d)))
+                    ;
+                closedir(d);
+            }
+            uproc_hist_record(hists[OP_READDIR], now_ns() - start);
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s", opts.mount_point, paths.files[xorshift(&seed) % paths.nfiles]);
+        start = now_ns();
+        stat(path, &st);
+        uproc_hist_record(hists[OP_STAT], now_ns() - start);
+
+        start = now_ns();
+        if ((fd = open(path, O_RDONLY)) >= 0) {
+            while (read(fd, buf, sizeof(buf)) > 0)
+                ;
+            close(fd);
+        }
+        uproc_hist_record(hists[OP_READ], now_ns() - start);
+    }
+    return NULL;
+}
+
+/* waits for the mount to serve the first file, returns 0 once it does */
+static int wait_mounted(int timeout_ms) {
+    char path[1024];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "%s/%s", opts.mount_point, paths.files[0]);
+    for (; timeout_ms > 0; timeout_ms -= 10) {
+        if (!stat(path, &st))
+            return 0;
+        usleep(10 * 1000);
+    }
+    return -ETIMEDOUT;
+}
+
+static void report(double seconds) {
+    uproc_hist_snapshot_t snap;
+    int i;
+
+    for (i = 0; i < OP_MAX; ++i) {
+        uproc_hist_snapshot(hists[i], &snap);
+        printf("{\"bench\":\"fuse\",\"tree\":\"%s\",\"entries\":%d,\"threads\":%d,\"loop\":\"%s\","
+               "\"seconds\":%.3f,\"op\":\"%s\",\"ops\":%llu,\"ops_per_sec\":%.1f,"
+               "\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu}\n",
+               opts.tree, paths.nfiles, opts.threads, opts.mt ? "mt" : "st", seconds, op_names[i],
+               (unsigned long long)snap.count, snap.count / seconds,
+               (unsigned long long)uproc_hist_percentile(&snap, 0.5),
+               (unsigned long long)uproc_hist_percentile(&snap, 0.99),
+               (unsigned long long)uproc_hist_percentile(&snap, 0.999),
+               (unsigned long long)snap.max);
+    }
+    fflush(stdout);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: fuse_bench [-t flat|deep|wide|conn] [-n entries] [-j threads] "
+                    "[-d seconds] [-m mountpoint] [-M]\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    pthread_t loop, *readers;
+    struct stat st;
+    uint64_t start;
+    double seconds;
+    int c, i, ret;
+
+    while ((c = getopt(argc, argv, "t:n:j:d:m:M")) != -1) {
+        switch (c) {
+        case 't': opts.tree = optarg; break;
+        case 'n': opts.entries = atoi(optarg); break;
+        case 'j': opts.threads = atoi(optarg); break;
+        case 'd': opts.seconds = atoi(optarg); break;
+        case 'm': opts.mount_point = optarg; break;
+        case 'M': opts.mt = 1; break;
+        default: usage();
+        }
+    }
+    if (opts.entries <= 0 || opts.threads <= 0 || opts.seconds <= 0)
+        usage();
+
+    if (mkdir(opts.mount_point, 0755) && errno != EEXIST) {
+        fprintf(stderr, "fuse_bench: can't create %s: %s\n", opts.mount_point, strerror(errno));
+        return 1;
+    }
+    if ((ret = uproc_ctx_init(&ctx, opts.mount_point, 0))) {
+        fprintf(stderr, "fuse_bench: failed to initialize uproc: %s\n", strerror(ret < 0 ? -ret : ret));
+        return 1;
+    }
+    if (build_tree(opts.tree, opts.entries))
+        usage();
+    for (i = 0; i < OP_MAX; ++i) {
+        if (!(hists[i] = uproc_hist_alloc())) {
+            fprintf(stderr, "fuse_bench: out of memory\n");
+            return 1;
+        }
+    }
+
+    if (pthread_create(&loop, NULL, run_thread, NULL))
+        return 1;
+    if (wait_mounted(5000)) {
+        fprintf(stderr, "fuse_bench: %s did not come up\n", opts.mount_point);
+        return 1;
+    }
+
+    readers = calloc(opts.threads, sizeof(*readers));
+    start = now_ns();
+    for (i = 0; i < opts.threads; ++i) {
+        if (pthread_create(&readers[i], NULL, reader_thread, (void*)(uintptr_t)i))
+            return 1;
+    }
+    sleep(opts.seconds);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    for (i = 0; i < opts.threads; ++i)
+        pthread_join(readers[i], NULL);
+    seconds = (now_ns() - start) / 1e9;
+    report(seconds);
+
+    // the loop only notices the exit request with the next operation
+    uproc_exit(&ctx);
+    stat(opts.mount_point, &st);
+    pthread_join(loop, NULL);
+
+    for (i = 0; i < OP_MAX; ++i)
+        uproc_hist_free(hists[i]);
+    free(readers);
+    return 0;
+}
@@ -0,0 +1,378 @@
+/*
+* In-process microbenchmarks of the code paths that do not need FUSE:
+* hashing, path walking and lookup, the hash table, registration of entries,
+* and the formatting and parsing of typed values.
+* src/uproc.c is compiled into this file so that its static functions can be called directly.
+* Every case is reported on its own line as a JSON object, e.g.
+*
+*   {"bench":"micro","case":"lookup_hit","entries":100000,"ops":1000000,"ns_per_op":61.2,
+*    "allocs_per_op":0.000,"bytes_per_op":0.0}
+*
+* The synthetic trees are laid out like per-object statistics, "<subsystem>/<id>/<field>",
+* with a handful of subsystems, numeric ids and field names of mixed lengths.
+*
+* usage: micro_bench [-n entries[,entries...]] [-c case]
+*/
+#include "../src/uproc.c"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+static const char *subsystems[] = { "net", "disk", "cpu", "tcp", "cache", "queue", "worker", "db" };
+static const char *fields[] = {
+    "rx", "tx", "rx_bytes", "tx_bytes", "errors", "drops", "state", "rtt_us",
+    "retransmits", "latency_p99_us", "queue_depth", "bytes_in_flight",
+    "connections_active", "requests_total", "tcp_retransmit_timeouts_total", "last_error",
+};
+#define NSUBSYSTEMS (sizeof(subsystems) / sizeof(*subsystems))
+#define NFIELDS     (sizeof(fields) / sizeof(*fields))
+
+/* cheap cases are repeated until at least this many operations ran */
+#define MIN_OPS     1000000
+
+/* allocations made by the program, counted by the wrappers below */
+static uint64_t allocs, alloc_bytes;
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+
+void *malloc(size_t size) {
+    ++allocs;
+    alloc_bytes += size;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    ++allocs;
+    alloc_bytes += n * size;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size) {
+    ++allocs;
+    alloc_bytes += size;
+    return __libc_realloc(p, size);
+}
+
+/* a synthetic tree, paths are kept back to back in @pool */
+typedef struct {
+    int       n;          // leaf entries
+    char     *pool;
+    size_t   *path;       // offset of the path of every leaf in @pool
+    size_t   *leaf;       // offset of the last part of every leaf in @pool
+    uint32_t *order;      // a random permutation of the leaves
+    uint64_t *values;
+} tree_t;
+
+typedef struct {
+    const char *name;
+    uint64_t    start, allocs, bytes;
+} sample_t;
+
+static const char *only;
+static volatile uint64_t sink;
+
+static int sample_begin(sample_t *s, const char *name) {
+    if (only && strcmp(only, name))
+        return 0;
+    s->name = name;
+    s->allocs = allocs;
+    s->bytes = alloc_bytes;
+    s->start = now_ns();
+    return 1;
+}
+
+static void sample_end(sample_t *s, int entries, uint64_t ops) {
+    uint64_t elapsed = now_ns() - s->start;
+
+    printf("{\"bench\":\"micro\",\"case\":\"%s\",\"entries\":%d,\"ops\":%llu,\"ns_per_op\":%.1f,"
+           "\"allocs_per_op\":%.3f,\"bytes_per_op\":%.1f}\n",
+           s->name, entries, (unsigned long long)ops, (double)elapsed / ops,
+           (double)(allocs - s->allocs) / ops, (double)(alloc_bytes - s->bytes) / ops);
+    fflush(stdout);
+}
+
+static void oom(void) {
+    fprintf(stderr, "micro_bench: out of memory\n");
+    exit(1);
+}
+
+static void tree_make(tree_t *t, int n) {
+    size_t cap = (size_t)n * 48, len = 0;
+    uint32_t seed = 2463534242u, j, tmp;
+    int i;
+
+    memset(t, 0, sizeof(*t));
+    t->n = n;
+    t->pool = malloc(cap);
+    t->path = malloc(n * sizeof(*t->path));
+    t->leaf = malloc(n * sizeof(*t->leaf));
+    t->order = malloc(n * sizeof(*t->order));
+    t->values = calloc(n, sizeof(*t->values));
+    if (!t->pool || !t->path || !t->leaf || !t->order || !t->values)
+        oom();
+
+    for (i = 0; i < n; ++i) {
+        // consecutive leaves share a directory, like the fields of one object
+        t->path[i] = len;
+        len += sprintf(t->pool + len, "%s/%d/", subsystems[i / NFIELDS % NSUBSYSTEMS],
+                       (int)(i / (NFIELDS * NSUBSYSTEMS)));
+        t->leaf[i] = len;
+        len += sprintf(t->pool + len, "%s", fields[i % NFIELDS]) + 1;
+        t->order[i] = i;
+    }
+    for (i = n - 1; i > 0; --i) {
+        j = xorshift(&seed) % (i + 1);
+        tmp = t->order[i];
+        t->order[i] = t->order[j];
+        t->order[j] = tmp;
+    }
+}
+
+static void tree_free(tree_t *t) {
+    free(t->pool);
+    free(t->path);
+    free(t->leaf);
+    free(t->order);
+    free(t->values);
+}
+
+/* registers the leaves of @t, making their directories on the way */
+static void tree_register(uproc_ctx_t *ctx, tree_t *t) {
+    uproc_dentry_t *subs[NSUBSYSTEMS] = { NULL }, *dir = NULL;
+    char name[16];
+    int i, sub;
+
+    for (i = 0; i < t->n; ++i) {
+        // every NFIELDS leaves start a directory of their own, see tree_make()
+        if (i % NFIELDS == 0) {
+            sub = i / NFIELDS % NSUBSYSTEMS;
+            if (!subs[sub] && !(subs[sub] = uproc_mkdir(ctx, subsystems[sub], NULL)))
+                oom();
+            snprintf(name, sizeof(name), "%d", (int)(i / (NFIELDS * NSUBSYSTEMS)));
+            if (!(dir = uproc_mkdir(ctx, name, subs[sub])))
+                oom();
+        }
+        if (!uproc_create_entry_uint64(ctx, t->pool + t->leaf[i], 0, dir, 0, &t->values[i]))
+            oom();
+    }
+}
+
+typedef struct {
+    struct hlist_node hlink;
+    unsigned          key;
+} node_t;
+
+static unsigned node_hash(struct hlist_node *p) {
+    return hlist_entry(p, node_t, hlink)->key;
+}
+
+static unsigned node_equal(struct hlist_node *p, void *d1, void *d2, void *d3) {
+    return hlist_entry(p, node_t, hlink)->key == (unsigned)(uintptr_t)d1;
+}
+
+static void bench_htable(tree_t *t) {
+    uproc_htable_t ht;
+    node_t *nodes;
+    sample_t s;
+    uint64_t ops, found = 0;
+    int i, r, rounds = MIN_OPS / t->n + 1;
+
+    nodes = calloc(t->n, sizeof(*nodes));
+    if (!nodes || uproc_htable_init(&ht, _UPROC_LOAD_FACTOR, node_hash, node_equal))
+        oom();
+    // keys as the dentries would get them, duplicates are left out of the table
+    for (i = 0; i < t->n; ++i)
+        nodes[i].key = __uproc_dentry_hash((uproc_dentry_t *)(uintptr_t)(i / NFIELDS * 64 + 4096),
+                                           t->pool + t->leaf[i], strlen(t->pool + t->leaf[i]));
+
+    if (sample_begin(&s, "htable_insert")) {
+        for (i = 0; i < t->n; ++i)
+            uproc_htable_insert(&ht, &nodes[i].hlink, nodes[i].key,
+                                (void*)(uintptr_t)nodes[i].key, NULL, NULL);
+        sample_end(&s, t->n, t->n);
+    } else {
+        for (i = 0; i < t->n; ++i)
+            uproc_htable_insert(&ht, &nodes[i].hlink, nodes[i].key,
+                                (void*)(uintptr_t)nodes[i].key, NULL, NULL);
+    }
+
+    if (sample_begin(&s, "htable_find_hit")) {
+        for (r = 0, ops = 0; r < rounds; ++r, ops += t->n) {
+            for (i = 0; i < t->n; ++i) {
+                unsigned key = nodes[t->order[i]].key;
+                found += !!uproc_htable_find(&ht, key, (void*)(uintptr_t)key, NULL, NULL);
+            }
+        }
+        sample_end(&s, t->n, ops);
+    }
+    if (sample_begin(&s, "htable_find_miss")) {
+        for (r = 0, ops = 0; r < rounds; ++r, ops += t->n) {
+            for (i = 0; i < t->n; ++i) {
+                unsigned key = ~nodes[t->order[i]].key;
+                found += !!uproc_htable_find(&ht, key, (void*)(uintptr_t)key, NULL, NULL);
+            }
+        }
+        sample_end(&s, t->n, ops);
+    }
+    sink += found;
+    uproc_htable_free(&ht);
+    free(nodes);
+}
+
+static void bench_tree(tree_t *t) {
+    uproc_ctx_t ctx;
+    uproc_dentry_t *parent, **ents;
+    const char *lp;
+    char buf[64], *path;
+    sample_t s;
+    uint64_t ops, acc = 0, v;
+    int64_t iv;
+    double dv;
+    size_t len;
+    int i, r, rounds = MIN_OPS / t->n + 1;
+
+    if (sample_begin(&s, "hash")) {
+        for (r = 0, ops = 0; r < rounds; ++r, ops += t->n) {
+            for (i = 0; i < t->n; ++i) {
+                lp = t->pool + t->leaf[t->order[i]];
+                acc += __uproc_dentry_hash((uproc_dentry_t *)t, lp, strlen(lp));
+            }
+        }
+        sample_end(&s, t->n, ops);
+    }
+
+    bench_htable(t);
+
+    if (uproc_ctx_init(&ctx, "micro_bench", 0))
+        oom();
+    if (sample_begin(&s, "register")) {
+        tree_register(&ctx, t);
+        sample_end(&s, t->n, t->n);
+    } else {
+        tree_register(&ctx, t);
+    }
+
+    if (sample_begin(&s, "find_last_part")) {
+        for (r = 0, ops = 0; r < rounds; ++r, ops += t->n) {
+            for (i = 0; i < t->n; ++i) {
+                parent = NULL;
+                acc += !__find_last_part(&ctx, t->pool + t->path[t->order[i]], &parent, &lp);
+            }
+        }
+        sample_end(&s, t->n, ops);
+    }
+
+    ents = malloc(t->n * sizeof(*ents));
+    if (!ents)
+        oom();
+    if (sample_begin(&s, "lookup_hit")) {
+        for (r = 0, ops = 0; r < rounds; ++r, ops += t->n) {
+            for (i = 0; i < t->n; ++i)
+                acc += !__uproc_lookup(&ctx, t->pool + t->path[t->order[i]], &ents[t->order[i]]);
+        }
+        sample_end(&s, t->n, ops);
+    } else {
+        for (i = 0; i < t->n; ++i)
+            __uproc_lookup(&ctx, t->pool + t->path[i], &ents[i]);
+    }
+    if (sample_begin(&s, "lookup_miss")) {
+        for (r = 0, ops = 0; r < rounds; ++r, ops += t->n) {
+            for (i = 0; i < t->n; ++i) {
+                // only the last part differs, the miss is found at the end of the walk
+                path = t->pool + t->path[t->order[i]];
+                path[t->leaf[t->order[i]] - t->path[t->order[i]]] ^= 0x20;
+                acc += !__uproc_lookup(&ctx, path, &parent);
+                path[t->leaf[t->order[i]] - t->path[t->order[i]]] ^= 0x20;
+            }
+        }
+        sample_end(&s, t->n, ops);
+    }
+
+    if (sample_begin(&s, "format_unchanged")) {
+        for (r = 0, ops = 0; r < rounds; ++r, ops += t->n) {
+            for (i = 0; i < t->n; ++i)
+                acc += uproc_read_entry(ents[t->order[i]], buf, sizeof(buf));
+        }
+        sample_end(&s, t->n, ops);
+    }
+    if (sample_begin(&s, "format_changed")) {
+        for (r = 0, ops = 0; r < rounds; ++r, ops += t->n) {
+            for (i = 0; i < t->n; ++i) {
+                t->values[t->order[i]] += 1234567;
+                acc += uproc_read_entry(ents[t->order[i]], buf, sizeof(buf));
+            }
+        }
+        sample_end(&s, t->n, ops);
+    }
+
+    // parse back what was formatted
+    for (i = 0; i < t->n; ++i)
+        t->values[i] = (uint64_t)i * 2654435761u;
+    if (sample_begin(&s, "parse_uint")) {
+        for (r = 0, ops = 0; r < rounds; ++r, ops += t->n) {
+            for (i = 0; i < t->n; ++i) {
+                len = snprintf(buf, sizeof(buf), "%llu\n", (unsigned long long)t->values[t->order[i]]);
+                acc += !uproc_parse_uint(buf, len, UINT64_MAX, &v) + v;
+            }
+        }
+        sample_end(&s, t->n, ops);
+    }
+    if (sample_begin(&s, "parse_int")) {
+        for (r = 0, ops = 0; r < rounds; ++r, ops += t->n) {
+            for (i = 0; i < t->n; ++i) {
+                len = snprintf(buf, sizeof(buf), "%lld\n", -(long long)(t->values[t->order[i]] >> 1));
+                acc += !uproc_parse_int(buf, len, INT64_MIN, INT64_MAX, &iv) + iv;
+            }
+        }
+        sample_end(&s, t->n, ops);
+    }
+    if (sample_begin(&s, "parse_double")) {
+        for (r = 0, ops = 0; r < rounds; ++r, ops += t->n) {
+            for (i = 0; i < t->n; ++i) {
+                len = snprintf(buf, sizeof(buf), "%.6f\n", t->values[t->order[i]] / 1000.0);
+                acc += !uproc_parse_double(buf, len, &dv) + (uint64_t)dv;
+            }
+        }
+        sample_end(&s, t->n, ops);
+    }
+
+    sink += acc;
+    free(ents);
+    uproc_destroy(&ctx);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: micro_bench [-n entries[,entries...]] [-c case]\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    const char *sizes = "1000,10000,100000", *p;
+    tree_t t;
+    char *end;
+    long n;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:c:")) != -1) {
+        switch (c) {
+        case 'n': sizes = optarg; break;
+        case 'c': only = optarg; break;
+        default: usage();
+        }
+    }
+
+    for (p = sizes; *p; p = *end ? end + 1 : end) {
+        n = strtol(p, &end, 10);
+        if (n <= 0 || n > INT32_MAX || (*end && *end != ','))
+            usage();
+        tree_make(&t, n);
+        bench_tree(&t);
+        tree_free(&t);
+    }
+    return 0;
+}
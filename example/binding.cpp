@@ -0,0 +1,46 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <deque>
+
+#include <uproc/uproc.hpp>
+
+int         connections = 12;
+double      load = 0.75;
+const long  max_connections = 1024;
+std::atomic<uint64_t> requests{0};
+std::deque<int> queue;
+int level = 1;
+
+int main(int argc, char const *argv[]) {
+    int ret;
+    uproc_ctx_t uproc_ctx;
+
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    if (ret) {
+        fprintf(stderr, "failed to initialize uproc %s\n", strerror(ret));
+        exit(-1);
+    }
+
+    /* readable writable entries, formatting is chosen from the variable type */
+    uproc_dentry_t *ent1 = uproc::expose(&uproc_ctx, "connections", connections, S_IRUSR | S_IWUSR);
+    uproc_dentry_t *ent2 = uproc::expose(&uproc_ctx, "load", load, S_IRUSR | S_IWUSR);
+    /* const variables are readonly */
+    uproc_dentry_t *ent3 = uproc::expose(&uproc_ctx, "max_connections", max_connections);
+    /* computed readonly entries */
+    uproc_dentry_t *ent4 = uproc::entry(&uproc_ctx, "requests", [] { return requests.load(); });
+    uproc_dentry_t *ent5 = uproc::entry(&uproc_ctx, "queue_len", [&] { return queue.size(); });
+    /* computed entry with a setter, writes are parsed as the getter's return type */
+    uproc_dentry_t *ent6 = uproc::entry(&uproc_ctx, "level",
+                                        [] { return level; },
+                                        [](int v) { if (v >= 0 && v <= 3) level = v; },
+                                        S_IRUSR | S_IWUSR);
+    if (!ent1 || !ent2 || !ent3 || !ent4 || !ent5 || !ent6) {
+        fprintf(stderr, "failed to create entries\n");
+        exit(-1);
+    }
+    uproc_run(&uproc_ctx);
+    return 0;
+}
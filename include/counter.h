@@ -0,0 +1,83 @@
+#ifndef _UPROC_COUNTER_H_
+#define _UPROC_COUNTER_H_
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#define UPROC_CACHELINE_SIZE 64
+/* number of per-thread slots of a counter */
+#define UPROC_COUNTER_NSLOTS 64
+
+typedef struct uproc_counter uproc_counter_t;
+
+struct uproc_counter_slot {
+    uint64_t v;
+} __attribute__((aligned(UPROC_CACHELINE_SIZE)));
+
+/*
+* A monotonic counter sharded by thread.
+* Each thread adds to its own cache line with a plain load and store,
+* so hot-path increments never contend. The slots are summed when read.
+* Threads are assigned slots on first use and give them back on exit,
+* if more than UPROC_COUNTER_NSLOTS threads are alive at once,
+* the extra ones share @overflow with atomic adds.
+*/
+struct uproc_counter {
+    struct uproc_counter_slot slots[UPROC_COUNTER_NSLOTS];
+    struct uproc_counter_slot overflow;
+};
+
+/* slot index + 1 of the calling thread, 0 if not assigned yet */
+extern __thread int __uproc_thread_slot;
+
+int __uproc_thread_slot_alloc(void);
+
+/*
+* Returns the slot index of the calling thread.
+* An index >= UPROC_COUNTER_NSLOTS means the thread has no slot of its own.
+*/
+static inline int uproc_thread_slot(void) {
+    int s = __uproc_thread_slot;
+    if (__builtin_expect(s == 0, 0))
+        s = __uproc_thread_slot_alloc();
+    return s - 1;
+}
+
+static inline void uproc_counter_add(uproc_counter_t *c, uint64_t n) {
+    int s = uproc_thread_slot();
+    if (__builtin_expect(s < UPROC_COUNTER_NSLOTS, 1)) {
+        uint64_t *p = &c->slots[s].v;
+        /* the slot is owned by this thread, no read-modify-write needed */
+        __atomic_store_n(p, __atomic_load_n(p, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&c->overflow.v, n, __ATOMIC_RELAXED);
+    }
+}
+
+static inline void uproc_counter_inc(uproc_counter_t *c) {
+    uproc_counter_add(c, 1);
+}
+
+/*
+* Initializes a counter to 0, a zero-filled counter is initialized too.
+*/
+void uproc_counter_init(uproc_counter_t *c);
+
+/*
+* Allocates a properly aligned counter, release it with free().
+* returns NULL on memory shortage.
+*/
+uproc_counter_t* uproc_counter_alloc(void);
+
+/*
+* Sums up the slots, the result is a value the counter had at some point
+* during the call.
+*/
+uint64_t uproc_counter_read(uproc_counter_t *c);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,141 @@
+#ifndef _UPROC_HISTOGRAM_H_
+#define _UPROC_HISTOGRAM_H_
+#include <stdint.h>
+
+#include "counter.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/*
+* Log-linear histogram of uint64_t values (e.g. latencies in nanoseconds).
+* Values below UPROC_HIST_SUB_COUNT get a bucket each, every power of two
+* above is split into UPROC_HIST_SUB_COUNT linear buckets, which bounds the
+* relative error of a reported percentile by 1 / UPROC_HIST_SUB_COUNT.
+*/
+#define UPROC_HIST_SUB_BITS  4
+#define UPROC_HIST_SUB_COUNT (1 << UPROC_HIST_SUB_BITS)
+#define UPROC_HIST_NBUCKETS  ((64 - UPROC_HIST_SUB_BITS + 1) * UPROC_HIST_SUB_COUNT)
+typedef struct uproc_hist          uproc_hist_t;
+typedef struct uproc_hist_snapshot uproc_hist_snapshot_t;
+
+struct uproc_hist_shard {
+    uint64_t sum;
+    uint64_t max;
+    uint64_t min_inv;   // ~min, so that a zero-filled shard needs no initialization
+    uint64_t buckets[UPROC_HIST_NBUCKETS];
+} __attribute__((aligned(UPROC_CACHELINE_SIZE)));
+
+/*
+* Sharded by thread like uproc_counter_t: every thread slot may have a shard of its own,
+* made by uproc_hist_thread_prepare() and written with plain loads and stores.
+* Threads without a slot or a shard share @overflow with atomic read-modify-writes.
+*/
+struct uproc_hist {
+    struct uproc_hist_shard *shards[UPROC_COUNTER_NSLOTS];
+    struct uproc_hist_shard  overflow;
+};
+
+/* merged view of all the shards */
+struct uproc_hist_snapshot {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[UPROC_HIST_NBUCKETS];
+};
+
+static inline unsigned uproc_hist_bucket(uint64_t v) {
+    unsigned e;
+    if (v < UPROC_HIST_SUB_COUNT)
+        return (unsigned)v;
+    e = 63 - __builtin_clzll(v);
+    return ((e - UPROC_HIST_SUB_BITS + 1) << UPROC_HIST_SUB_BITS) +
+           (unsigned)((v >> (e - UPROC_HIST_SUB_BITS)) & (UPROC_HIST_SUB_COUNT - 1));
+}
+
+/* adds @n to *@p, which only the calling thread writes */
+static inline void __uproc_hist_add(uint64_t *p, uint64_t n) {
+    __atomic_store_n(p, __atomic_load_n(p, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+/* raises *@p, which only the calling thread writes, to @v */
+static inline void __uproc_hist_max(uint64_t *p, uint64_t v) {
+    if (v > __atomic_load_n(p, __ATOMIC_RELAXED))
+        __atomic_store_n(p, v, __ATOMIC_RELAXED);
+}
+
+/* raise the shared *@p to @v, a CAS is only issued when @v is a new extreme */
+static inline void __uproc_hist_raise(uint64_t *p, uint64_t v) {
+    uint64_t cur = __atomic_load_n(p, __ATOMIC_RELAXED);
+    while (v > cur &&
+           !__atomic_compare_exchange_n(p, &cur, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+/*
+* Records @v, safe to call from any thread, wait-free and never allocates.
+* Once the calling thread has its shard, see uproc_hist_thread_prepare(), it costs
+* a few plain loads and stores on cache lines no other thread writes.
+* Until then, and for threads without a slot of their own, it falls back
+* to atomic adds on @overflow.
+*/
+static inline void uproc_hist_record(uproc_hist_t *h, uint64_t v) {
+    int slot = uproc_thread_slot();
+    struct uproc_hist_shard *s = NULL;
+
+    if (__builtin_expect(slot < UPROC_COUNTER_NSLOTS, 1))
+        s = __atomic_load_n(&h->shards[slot], __ATOMIC_RELAXED);
+    if (__builtin_expect(s != NULL, 1)) {
+        __uproc_hist_add(&s->buckets[uproc_hist_bucket(v)], 1);
+        __uproc_hist_add(&s->sum, v);
+        __uproc_hist_max(&s->max, v);
+        __uproc_hist_max(&s->min_inv, ~v);
+    } else {
+        s = &h->overflow;
+        __atomic_fetch_add(&s->buckets[uproc_hist_bucket(v)], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&s->sum, v, __ATOMIC_RELAXED);
+        __uproc_hist_raise(&s->max, v);
+        __uproc_hist_raise(&s->min_inv, ~v);
+    }
+}
+
+/*
+* Initializes a histogram, a zero-filled histogram is initialized too.
+* Release the shards of an initialized histogram with uproc_hist_destroy().
+*/
+void uproc_hist_init(uproc_hist_t *h);
+void uproc_hist_destroy(uproc_hist_t *h);
+
+/*
+* Allocates a properly aligned histogram, release it with uproc_hist_free().
+* returns NULL on memory shortage.
+*/
+uproc_hist_t* uproc_hist_alloc(void);
+void uproc_hist_free(uproc_hist_t *h);
+
+/*
+* Makes the shard of the calling thread, for its records to take the fast path.
+* Meant to be called once per thread and histogram before recording, e.g. when the
+* thread starts, since it allocates; it only checks for the shard afterwards.
+* A slot outlives the threads owning it, so does its shard and what it recorded.
+* returns 0 on success or if the thread has no slot of its own, -ENOMEM on memory shortage.
+*/
+int uproc_hist_thread_prepare(uproc_hist_t *h);
+
+/*
+* Merges the shards of @h into @snap.
+*/
+void uproc_hist_snapshot(uproc_hist_t *h, uproc_hist_snapshot_t *snap);
+
+/*
+* Returns the value below which a fraction @q (0 <= @q <= 1) of the recorded values fall,
+* reported as the highest value of the bucket it falls into, clamped to [min, max].
+*/
+uint64_t uproc_hist_percentile(const uproc_hist_snapshot_t *snap, double q);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
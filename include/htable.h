@@ -41,6 +41,18 @@ struct hlist_node* uproc_htable_find(uproc_htable_t *ht, unsigned key,
                                      void *d1, void *d2, void*d3);
 
 void uproc_htable_free(uproc_htable_t *ht);
+
+/* occupancy of a hash table, see uproc_htable_stats() */
+typedef struct uproc_htable_stats {
+    int    len;        // number of buckets
+    int    n_entries;
+    int    used;       // buckets holding at least one entry
+    int    max_chain;  // entries in the fullest bucket
+    double load;       // n_entries / len
+} uproc_htable_stats_t;
+
+/* walks the buckets of @ht, O(len + n_entries) */
+void uproc_htable_stats(uproc_htable_t *ht, uproc_htable_stats_t *st);
 #ifdef __cplusplus
 }
 #endif
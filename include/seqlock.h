@@ -0,0 +1,77 @@
+#ifndef _UPROC_SEQLOCK_H_
+#define _UPROC_SEQLOCK_H_
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/*
+* Sequence lock for groups of values updated together.
+* The writer makes the sequence odd while it updates the group and never blocks,
+* readers retry until they saw the same even sequence before and after reading.
+* Writers of the same seqlock must be serialized by the application.
+* If uproc itself is to write a group, e.g. with uproc_apply(), the application
+* declares the mutex its writers hold, see uproc_entry_set_writer_lock().
+*
+*   uproc_write_seqbegin(&sl);
+*   st.bytes += len;
+*   st.packets++;
+*   uproc_write_seqend(&sl);
+*/
+typedef struct uproc_seqlock {
+    unsigned seq;
+} uproc_seqlock_t;
+
+#define UPROC_SEQLOCK_INIT { 0 }
+
+static inline void uproc_seqlock_init(uproc_seqlock_t *sl) {
+    sl->seq = 0;
+}
+
+static inline void uproc_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+static inline void uproc_write_seqbegin(uproc_seqlock_t *sl) {
+    __atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELAXED);
+    /* the odd sequence is visible before any of the updates */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void uproc_write_seqend(uproc_seqlock_t *sl) {
+    __atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+* For groups that several threads may refresh, such as caches:
+* returns non-zero if the caller became the writer, zero if another one is active.
+*/
+static inline int uproc_write_seqtrybegin(uproc_seqlock_t *sl) {
+    unsigned seq = __atomic_load_n(&sl->seq, __ATOMIC_RELAXED);
+
+    if ((seq & 1) || !__atomic_compare_exchange_n(&sl->seq, &seq, seq + 1, 0,
+                                                  __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        return 0;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return 1;
+}
+
+static inline unsigned uproc_read_seqbegin(const uproc_seqlock_t *sl) {
+    unsigned seq;
+    while ((seq = __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE)) & 1)
+        uproc_cpu_relax();
+    return seq;
+}
+
+/* returns non-zero if the values read since uproc_read_seqbegin() may be inconsistent */
+static inline int uproc_read_seqretry(const uproc_seqlock_t *sl, unsigned seq) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&sl->seq, __ATOMIC_RELAXED) != seq;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
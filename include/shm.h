@@ -0,0 +1,177 @@
+#ifndef _UPROC_SHM_H_
+#define _UPROC_SHM_H_
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "seqlock.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/*
+* Layout of the shared-memory export, see uproc_shm_open().
+* The segment starts with a header, followed by @capacity directory entries
+* and @capacity slots. Entries are only ever appended, a reader sees the first
+* @nentries of them, each one describing the slot its value is kept in.
+* Slots take a cache line each, so that the writers of different slots don't contend.
+* Values are in the byte order of the binary records, see uproc_render_entry_binary().
+*/
+#define UPROC_SHM_MAGIC     0x75707368  // "upsh"
+#define UPROC_SHM_VERSION   2
+#define UPROC_SHM_PATH_MAX  112
+#define UPROC_SHM_SLOT_ALIGN 64
+
+typedef struct uproc_shm_hdr {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;      // number of directory entries and slots
+    uint32_t nentries;      // published directory entries
+} uproc_shm_hdr_t;
+
+typedef struct uproc_shm_dirent {
+    char     path[UPROC_SHM_PATH_MAX]; // null-terminated, relative to the root directory
+    uint32_t type;          // uproc_type_t
+    uint32_t size;          // size of the value
+    uint64_t offset;        // of the slot, from the start of the segment
+} uproc_shm_dirent_t;
+
+typedef struct uproc_shm_slot {
+    uproc_seqlock_t seq;
+    uint32_t        pad;
+    char            value[16];
+} __attribute__((aligned(UPROC_SHM_SLOT_ALIGN))) uproc_shm_slot_t;
+
+/*
+* Writer side of a slot handed out by uproc_shm_slot(), one writer at a time.
+* Stores the @size bytes of the value @v, in the byte order of the binary records.
+* returns 0 on success, or -EINVAL if the value does not fit in a slot.
+*/
+static inline int uproc_shm_slot_write(uproc_shm_slot_t *slot, const void *v, size_t size) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    const char *src = (const char *)v;
+    size_t i;
+#endif
+
+    if (size > sizeof(slot->value))
+        return -EINVAL;
+    uproc_write_seqbegin(&slot->seq);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (i = 0; i < size; ++i)
+        slot->value[i] = src[size - 1 - i];
+#else
+    memcpy(slot->value, v, size);
+#endif
+    uproc_write_seqend(&slot->seq);
+    return 0;
+}
+
+/* offset of the first slot, past the directory entries */
+#define UPROC_SHM_SLOTS(capacity) ((sizeof(uproc_shm_hdr_t) + (capacity) * sizeof(uproc_shm_dirent_t) + \
+                                    UPROC_SHM_SLOT_ALIGN - 1) & ~(size_t)(UPROC_SHM_SLOT_ALIGN - 1))
+#define UPROC_SHM_SIZE(capacity)  (UPROC_SHM_SLOTS(capacity) + (capacity) * sizeof(uproc_shm_slot_t))
+
+/*
+* Reader side, needs neither FUSE nor libuproc.
+* Values are sampled with plain loads, no syscall is involved after uproc_shm_attach().
+*
+*   uproc_shm_reader_t r;
+*   uint64_t rx;
+*   uproc_shm_attach(&r, "/myapp");
+*   const uproc_shm_dirent_t *d = uproc_shm_find(&r, "net/rx");
+*   uproc_shm_read(&r, d, &rx, sizeof(rx));
+*/
+typedef struct uproc_shm_reader {
+    const char *base;
+    size_t      size;
+} uproc_shm_reader_t;
+
+static inline const uproc_shm_hdr_t* uproc_shm_hdr(const uproc_shm_reader_t *r) {
+    return (const uproc_shm_hdr_t *)r->base;
+}
+
+/* returns 0 on success, otherwise a negative error code */
+static inline int uproc_shm_attach(uproc_shm_reader_t *r, const char *name) {
+    const uproc_shm_hdr_t *hdr;
+    struct stat st;
+    void *p;
+    int fd;
+
+    // a reader which failed to attach can still be detached
+    memset(r, 0, sizeof(*r));
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return -errno;
+    if (fstat(fd, &st) || (size_t)st.st_size < sizeof(uproc_shm_hdr_t)) {
+        close(fd);
+        return -EINVAL;
+    }
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return -errno;
+
+    hdr = (const uproc_shm_hdr_t *)p;
+    if (hdr->magic != UPROC_SHM_MAGIC || hdr->version != UPROC_SHM_VERSION ||
+        UPROC_SHM_SIZE(hdr->capacity) > (size_t)st.st_size) {
+        munmap(p, st.st_size);
+        return -EINVAL;
+    }
+    r->base = (const char *)p;
+    r->size = st.st_size;
+    return 0;
+}
+
+static inline void uproc_shm_detach(uproc_shm_reader_t *r) {
+    if (r->base)
+        munmap((void *)r->base, r->size);
+    r->base = NULL;
+}
+
+/* number of directory entries published so far */
+static inline unsigned uproc_shm_count(const uproc_shm_reader_t *r) {
+    return __atomic_load_n(&uproc_shm_hdr(r)->nentries, __ATOMIC_ACQUIRE);
+}
+
+static inline const uproc_shm_dirent_t* uproc_shm_dirent(const uproc_shm_reader_t *r, unsigned i) {
+    return (const uproc_shm_dirent_t *)(r->base + sizeof(uproc_shm_hdr_t)) + i;
+}
+
+/* the directory entry of @path, NULL if it is not exported (yet) */
+static inline const uproc_shm_dirent_t* uproc_shm_find(const uproc_shm_reader_t *r, const char *path) {
+    unsigned i, n = uproc_shm_count(r);
+
+    for (i = 0; i < n; ++i) {
+        if (!strcmp(uproc_shm_dirent(r, i)->path, path))
+            return uproc_shm_dirent(r, i);
+    }
+    return NULL;
+}
+
+/*
+* Copies a consistent snapshot of the value of @d into @v.
+* returns the size of the value, or -ENOSPC if it does not fit in @size bytes.
+*/
+static inline int uproc_shm_read(const uproc_shm_reader_t *r, const uproc_shm_dirent_t *d,
+                                 void *v, size_t size) {
+    const uproc_shm_slot_t *slot = (const uproc_shm_slot_t *)(r->base + d->offset);
+    unsigned seq;
+
+    if (d->size > size)
+        return -ENOSPC;
+    do {
+        seq = uproc_read_seqbegin(&slot->seq);
+        memcpy(v, slot->value, d->size);
+    } while (uproc_read_seqretry(&slot->seq, seq));
+    return d->size;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -5,9 +5,14 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "list.h"
 #include "htable.h"
+#include "counter.h"
+#include "histogram.h"
+#include "seqlock.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -27,8 +32,72 @@ typedef struct uproc_buf       uproc_buf_t;
 * @private_data: user data provided by your program at the registration.
 */
 typedef int (*uproc_handler_t)(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data);
+/*
+* Types of the variables exported by the wrappers.
+*/
+typedef enum {
+    UPROC_TYPE_NONE = 0,    // custom handlers
+    UPROC_TYPE_UCHAR,
+    UPROC_TYPE_USHORT,
+    UPROC_TYPE_UINT,
+    UPROC_TYPE_ULONG,
+    UPROC_TYPE_ULLONG,
+    UPROC_TYPE_UINT16,
+    UPROC_TYPE_UINT32,
+    UPROC_TYPE_UINT64,
+    UPROC_TYPE_CHAR,
+    UPROC_TYPE_SHORT,
+    UPROC_TYPE_INT,
+    UPROC_TYPE_LONG,
+    UPROC_TYPE_LLONG,
+    UPROC_TYPE_FLOAT,
+    UPROC_TYPE_DOUBLE,
+    UPROC_TYPE_LDOUBLE,
+    UPROC_TYPE_INT16,
+    UPROC_TYPE_INT32,
+    UPROC_TYPE_INT64,
+    UPROC_TYPE_COUNTER,     // uproc_counter_t
+    UPROC_TYPE_HIST,        // uproc_hist_t
+    UPROC_TYPE_MAX
+} uproc_type_t;
+
 typedef uproc_handler_t uproc_read_proc_t ;
 typedef uproc_handler_t uproc_write_proc_t;
+/*
+* Called with @private_data when the entry is destroyed,
+* lets an entry own the memory of its user data.
+*/
+typedef void (*uproc_free_proc_t)(void *private_data);
+
+/*
+* Growable buffer for content whose size is not known in advance.
+* A zeroed uproc_strbuf_t is an empty buffer, release it with uproc_strbuf_free().
+*/
+typedef struct uproc_strbuf {
+    char   *data;   // not null-terminated
+    size_t  len;
+    size_t  cap;
+} uproc_strbuf_t;
+
+/*
+* Renders the whole content of an entry by appending it to @out.
+* Used instead of a read handler by entries whose size is not bounded,
+* the content is rendered once per open and then read in slices.
+* returns 0 on success, otherwise a negative error code.
+*/
+typedef int (*uproc_render_proc_t)(uproc_strbuf_t *out, void *private_data);
+
+/*
+* Handlers of asynchronous entries answer later, from any thread, see uproc_create_entry_async().
+* @token: completed exactly once with uproc_complete() or uproc_complete_error().
+* @in, @len: the bytes written, @in is NULL for reads. They stay valid until @token is completed.
+* returns UPROC_PENDING once @token is handed over, or a negative error code
+* without completing @token.
+*/
+typedef struct uproc_token uproc_token_t;
+typedef int (*uproc_async_proc_t)(uproc_token_t *token, const char *in, size_t len,
+                                  void *private_data);
+#define UPROC_PENDING 1
 
 struct uproc_ctx {
     uproc_dentry_t  *root;  // root dir entry
@@ -41,8 +110,24 @@ struct uproc_ctx {
     const char      *mount_point;
     struct fuse     *fuse;
     int              dbg; // if debug is on
+    int              bulk; // formats of the bulk files made along with every directory, see uproc_enable_bulk()
+    struct uproc_shm *shm; // shared-memory export, see uproc_shm_open()
+    struct uproc_stats *stats; // self-instrumentation, see uproc_enable_stats()
+    /*
+    * Entries may be registered from any thread while the loop serves the tree:
+    * lookups, directory listings and the registration itself take @lock.
+    * Registered entries are never freed before uproc_destroy().
+    */
+    pthread_rwlock_t lock;
 };
 
+/* flags of uproc_dentry_t */
+#define UPROC_DENTRY_VIRTUAL    0x1 // made by uproc itself, left out of bulk reads
+#define UPROC_DENTRY_QUERY      0x2 // the query file, see uproc_enable_query()
+#define UPROC_DENTRY_SINGLE_FLIGHT 0x4 // concurrent reads share one render, see uproc_entry_set_single_flight()
+#define UPROC_DENTRY_ASSEMBLE   0x8 // writes are delivered whole on close, see uproc_entry_set_assembled()
+#define UPROC_DENTRY_SHM_OWNED  0x10 // the application writes the shared-memory slot, see uproc_shm_slot()
+
 struct uproc_dentry {
     char               *name;
     size_t              namelen;
@@ -55,13 +140,49 @@ struct uproc_dentry {
     void *              private_data; // used by user
     uproc_read_proc_t   read_proc;
     uproc_read_proc_t   write_proc;
+    uproc_free_proc_t   free_proc;    // releases @private_data, optional
+    uproc_type_t        type;         // type of the variable exported by a wrapper
+    uproc_seqlock_t    *seqlock;      // guards the values read by read_proc, optional
+    pthread_mutex_t    *writer_lock;  // held by the writers of @seqlock, see uproc_entry_set_writer_lock()
+    uproc_render_proc_t render_proc;  // renders the whole content, used instead of read_proc if set
+    unsigned            flags;        // UPROC_DENTRY_*
+    unsigned            shm_slot;     // 1-based slot in the shared-memory export, 0 if none
+    void               *metric;       // cached exposition name, see uproc_enable_metrics()
+    struct uproc_cache *cache;        // last rendered content, see uproc_entry_set_cache_ttl()
+    struct uproc_published *published; // content published by the program, see uproc_publish()
+    unsigned char       publock;      // guards @published
+    struct uproc_fmt_cache *fmt;      // last value and text of a primitive wrapper
+    uproc_async_proc_t  async_proc;   // answers reads and writes later, see uproc_create_entry_async()
+    struct uproc_budget *budget;      // latency budget of the handlers, see uproc_entry_set_budget()
+    struct uproc_cost  *cost;         // what the handlers cost, see uproc_enable_stats()
 };
 
+/*
+* First child of @dir, for walking a directory without taking ctx->lock.
+* Children are only ever prepended, each one set up before it is published,
+* and the @next of an entry never changes afterwards.
+*/
+static inline uproc_dentry_t* uproc_dentry_children(uproc_dentry_t *dir) {
+    return __atomic_load_n(&dir->children, __ATOMIC_ACQUIRE);
+}
+
+/* CLOCK_MONOTONIC in nanoseconds, the clock of the timestamps kept by uproc */
+static inline uint64_t __uproc_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 struct uproc_buf {
     char            *mem;
     size_t           size;
     uproc_dentry_t  *entry;
     int              done;
+    uproc_strbuf_t   out;   // content rendered by render_proc
+    uproc_strbuf_t   in;    // paths written to the query file, or the writes being assembled
+    off_t            base;  // file offset @out is served from
+    int              answered; // a read answered the paths in @in
+    size_t           held;  // bytes of @out and @in counted in ctx->stats
 };
 
 /*
@@ -81,6 +202,13 @@ int uproc_ctx_init(uproc_ctx_t *ctx, const char *mount_point, int dbg);
 */
 int uproc_run(uproc_ctx_t *ctx);
 
+/*
+* Same as uproc_run(), but serves requests from a pool of threads,
+* so a slow handler does not hold up reads of other entries.
+* Handlers may then be called concurrently, see uproc_entry_set_single_flight().
+*/
+int uproc_run_mt(uproc_ctx_t *ctx);
+
 /*
 * Unregisters all the uproc entry from the filesystem and deallocates memory. 
 */
@@ -147,6 +275,407 @@ uproc_dentry_t* uproc_create_entry(uproc_ctx_t *ctx,
                                    uproc_write_proc_t write_proc, // write handler
                                    void *private_data);           // user data
 
+/*
+* Two-step uproc_create_entry(), for wrappers which set up more of the entry:
+* uproc_entry_prepare() makes the entry without adding it to the tree,
+* the wrapper fills in the rest (type, flags, render_proc...), then uproc_entry_commit() adds it.
+* Other threads may walk a committed entry at any time, so whatever they read is set before.
+* uproc_entry_commit() returns 0 on success, otherwise a negative error code and @entry is freed,
+* its @private_data is left to the caller.
+*/
+uproc_dentry_t* uproc_entry_prepare(uproc_ctx_t *ctx,
+                                    const char *name,
+                                    mode_t mode,
+                                    size_t size,
+                                    uproc_dentry_t* parent,
+                                    uproc_read_proc_t read_proc,
+                                    uproc_write_proc_t write_proc,
+                                    void *private_data);
+int uproc_entry_commit(uproc_ctx_t *ctx, uproc_dentry_t *entry);
+
+/*
+* Make a uproc entry whose content is rendered as a whole by @render_proc.
+* The entry has no size limit, it is rendered at the first read of a handle
+* and again at every read after EOF.
+*/
+uproc_dentry_t* uproc_create_entry_render(uproc_ctx_t *ctx,
+                                          const char *name, // name of the entry
+                                          mode_t mode,      // permissions
+                                          uproc_dentry_t* parent,
+                                          uproc_render_proc_t render_proc,
+                                          void *private_data);
+
+/* policies of uproc_entry_set_budget() */
+#define UPROC_BUDGET_LOG    0 // only count and log the slow calls
+#define UPROC_BUDGET_EAGAIN 1 // fail with EAGAIN while the handler is short-circuited
+#define UPROC_BUDGET_STALE  2 // serve the last content while the handler is short-circuited, EAGAIN if none
+
+/*
+* Gives every call of the handlers of @entry a budget of @budget_ms milliseconds.
+* Calls over budget are counted and logged with the path of the entry.
+* Unless @policy is UPROC_BUDGET_LOG, the handler is short-circuited while a call of it
+* runs over budget, e.g. stuck on a lock, and for a second after 3 slow calls in a row.
+* With UPROC_BUDGET_STALE the entry is rendered as a whole, see uproc_create_entry_render().
+* @budget_ms 0 removes the budget, it may be changed while the entry is read.
+* returns 0 on success, otherwise a negative error code.
+*/
+int uproc_entry_set_budget(uproc_dentry_t *entry, unsigned budget_ms, int policy);
+
+/* number of calls of the handlers of @entry which ran over budget */
+unsigned long uproc_entry_slow_calls(uproc_dentry_t *entry);
+
+/*
+* Make a uproc entry whose reads and writes are answered asynchronously.
+* @async_proc only hands the request over, e.g. to the thread owning the data,
+* which answers with uproc_complete(). The request waits for the answer in its uproc thread,
+* run the loop with uproc_run_mt() so that other requests are served in the meantime.
+* A request fails with ETIMEDOUT if it is not answered within the budget of the entry
+* (see uproc_entry_set_budget(), UPROC_BUDGET_LOG aside), or UPROC_ASYNC_TIMEOUT_MS without one.
+* Reads are rendered as a whole like uproc_create_entry_render() entries.
+*/
+#define UPROC_ASYNC_TIMEOUT_MS  5000
+uproc_dentry_t* uproc_create_entry_async(uproc_ctx_t *ctx,
+                                         const char *name, // name of the entry
+                                         mode_t mode,      // permissions
+                                         uproc_dentry_t* parent,
+                                         uproc_async_proc_t async_proc,
+                                         void *private_data);
+
+/*
+* Answers the request of @token with @len bytes of @data, from any thread.
+* @data is the content of a read and is ignored for writes, which are accepted as a whole.
+* @token is released, it must not be used afterwards.
+* returns 0 on success, otherwise a negative error code which the request fails with.
+*/
+int uproc_complete(uproc_token_t *token, const void *data, size_t len);
+
+/* Fails the request of @token with the negative error code @err, and releases @token */
+void uproc_complete_error(uproc_token_t *token, int err);
+
+/*
+* Appends the whole content of @entry to @out, calling its read handler
+* as many times as a sequence of read(2)s until EOF would.
+* returns 0 on success, otherwise a negative error code.
+*/
+int uproc_render_entry(uproc_dentry_t *entry, uproc_strbuf_t *out);
+
+int  uproc_strbuf_reserve(uproc_strbuf_t *sb, size_t n);  // makes room for @n more bytes
+int  uproc_strbuf_append(uproc_strbuf_t *sb, const char *data, size_t len);
+int  uproc_strbuf_printf(uproc_strbuf_t *sb, const char *fmt, ...)
+                         __attribute__((format(printf, 2, 3)));
+void uproc_strbuf_free(uproc_strbuf_t *sb);
+
+/*
+* Binary form of the entries exported by the primitive and counter wrappers,
+* for readers which would rather not format and parse text.
+* All integers are little-endian.
+*   entry record: u8 type (uproc_type_t), u8 size, value[size]
+* The value is the raw variable, two's complement integers and IEEE 754 floats
+* in little-endian byte order, a long double is in the layout of the host.
+* Counters are u64.
+*/
+#define UPROC_BINARY_HDR_SIZE   2
+
+/*
+* Appends the binary record of @entry to @out, read under its seqlock if any.
+* returns 0 on success, -ENOTSUP if @entry has no binary form,
+* otherwise a negative error code.
+*/
+int uproc_render_entry_binary(uproc_dentry_t *entry, uproc_strbuf_t *out);
+
+/*
+* Make a readonly entry which renders the binary record of @target.
+* For a binary view of a whole directory, see UPROC_BULK_BINARY.
+*/
+uproc_dentry_t* uproc_create_entry_binary(uproc_ctx_t *ctx,
+                                          const char *name, // name of the entry
+                                          mode_t mode,      // permissions
+                                          uproc_dentry_t* parent,
+                                          uproc_dentry_t *target);
+
+/*
+* Formats of the bulk files.
+* UPROC_BULK_TEXT: one "path value" line per line of every value.
+* UPROC_BULK_JSON: one flat object of "path": "value" members.
+* UPROC_BULK_BINARY: packed array of "u16 pathlen, path[pathlen], entry record",
+*                    one for every entry which has a binary form.
+* Paths are relative to the directory of the bulk file.
+*/
+#define UPROC_BULK_TEXT         0x1
+#define UPROC_BULK_JSON         0x2
+#define UPROC_BULK_BINARY       0x4
+
+#define UPROC_BULK_TEXT_NAME    ".all"
+#define UPROC_BULK_JSON_NAME    ".all.json"
+#define UPROC_BULK_BINARY_NAME  ".all.bin"
+
+/*
+* Make a readonly bulk file in @dir which renders every readable entry
+* of the subtree of @dir in one stream, so it can be scraped with a single open.
+* @name: name of the file, UPROC_BULK_*_NAME of @format if NULL.
+* @format: one of UPROC_BULK_TEXT, UPROC_BULK_JSON and UPROC_BULK_BINARY.
+* If a seqlock guards @dir, the whole subtree is rendered as one consistent snapshot.
+*/
+uproc_dentry_t* uproc_create_entry_bulk(uproc_ctx_t *ctx,
+                                        const char *name, // name of the entry
+                                        uproc_dentry_t *dir,
+                                        int format);
+
+/*
+* Makes bulk files of @formats in the root directory and in every directory
+* made by uproc_mkdir() from now on.
+* @formats: any of UPROC_BULK_TEXT, UPROC_BULK_JSON and UPROC_BULK_BINARY.
+* returns 0 on success, otherwise a negative error code.
+*/
+int uproc_enable_bulk(uproc_ctx_t *ctx, int formats);
+
+/*
+* Makes a query file in the root directory, for reading many entries at once.
+* A client opens it for reading and writing, writes a newline-separated list of paths
+* and reads back one "path value" line per line of every value, in the order asked for.
+* Entries which can't be read are answered with "path !reason".
+* The paths stay on the handle, so reading on after EOF answers them again with fresh values,
+* the next write after a read starts a new list.
+* returns 0 on success, otherwise a negative error code.
+*/
+#define UPROC_QUERY_NAME        ".query"
+int uproc_enable_query(uproc_ctx_t *ctx);
+
+/*
+* Answers the query @paths of @len bytes from within the program,
+* appending to @out what a read of the query file would return.
+* returns 0 on success, otherwise a negative error code.
+*/
+int uproc_query(uproc_ctx_t *ctx, const char *paths, size_t len, uproc_strbuf_t *out);
+
+/*
+* Applies a batch of "path value" lines to the entries below @dir, all of them or none.
+* Paths are relative to @dir, blank lines and lines starting with '#' are skipped.
+* Every value is first parsed into scratch space by the write handler of its entry,
+* the first one refused fails the whole batch and no entry is changed.
+* Then the values are stored, within a write section of every seqlock guarding them,
+* so that readers see the batch in full or not at all. The writer locks of those seqlocks
+* are held meanwhile, in address order, see uproc_entry_set_writer_lock().
+* Entries guarded by a seqlock without a writer lock are refused with ENOLCK.
+* Only the primitive wrappers, including the fields of uproc_mkdir_struct(),
+* and string entries can be applied, other entries are refused with EOPNOTSUPP.
+* Batches are applied one at a time.
+* @status: if not NULL, "applied N\n" or "line N: path: reason\n" is appended to it.
+* returns 0 on success, otherwise a negative error code.
+*/
+int uproc_apply(uproc_ctx_t *ctx, uproc_dentry_t *dir, const char *batch, size_t len,
+                uproc_strbuf_t *status);
+
+/*
+* Make a control file in @dir which applies the batches written to it with uproc_apply().
+* A batch is applied when the handle is closed, the error of a refused batch is returned by close().
+* Reading the file tells the outcome of the last batch.
+* @name: name of the file, UPROC_APPLY_NAME if NULL.
+*/
+#define UPROC_APPLY_NAME        ".apply"
+uproc_dentry_t* uproc_create_entry_apply(uproc_ctx_t *ctx,
+                                         const char *name, // name of the entry
+                                         uproc_dentry_t *dir);
+
+/*
+* Looks up the entry at @path, relative to the root directory.
+* returns NULL if it does not exist.
+*/
+uproc_dentry_t* uproc_lookup(uproc_ctx_t *ctx, const char *path);
+
+/*
+* Writes the path of @entry relative to the root directory to @buf, null-terminated.
+* returns its length, or -ENAMETOOLONG if it does not fit in @size bytes.
+*/
+int uproc_entry_path(uproc_dentry_t *entry, char *buf, size_t size);
+
+/*
+* Shared-memory export, for readers which sample values without any syscall.
+* Mirrors every entry which has a binary form (see uproc_render_entry_binary())
+* into the POSIX shared-memory object @name, readable with the reader in "shm.h".
+* @capacity: maximum number of entries exported, later ones are left out.
+* The object is created readable by the owner only.
+* returns 0 on success, -EEXIST if @name exists already, e.g. another instance exports to it
+* or one which crashed left it behind (shm_unlink(3) it), otherwise a negative error code.
+* Note: the object is unlinked by uproc_shm_close() and uproc_destroy().
+*/
+int uproc_shm_open(uproc_ctx_t *ctx, const char *name, unsigned capacity);
+
+/*
+* Copies the current value of every exported entry into its slot,
+* exporting the entries registered since the previous call.
+* Each slot is updated in place under its own seqlock, readers never block.
+* Renders every entry, meant for a sampling thread at a modest rate.
+* May be called from any thread, calls are serialized with uproc_shm_update().
+* returns the number of entries exported, otherwise a negative error code.
+*/
+int uproc_shm_sync(uproc_ctx_t *ctx);
+
+/* Copies the current value of @entry into its slot, if it is exported, from any thread */
+void uproc_shm_update(uproc_ctx_t *ctx, uproc_dentry_t *entry);
+
+/*
+* Hands the slot of @entry over to the application, exporting @entry if needed,
+* for hot values updated without rendering: the owner stores each new value
+* with uproc_shm_slot_write() (see "shm.h"), from one thread at a time.
+* uproc_shm_sync() and uproc_shm_update() leave the slot alone from then on.
+* The slot stays valid until uproc_shm_close().
+* returns NULL if @entry can't be exported.
+*/
+struct uproc_shm_slot* uproc_shm_slot(uproc_ctx_t *ctx, uproc_dentry_t *entry);
+
+void uproc_shm_close(uproc_ctx_t *ctx);
+
+/* FUSE operations timed by the self-instrumentation */
+typedef enum {
+    UPROC_OP_GETATTR,
+    UPROC_OP_OPEN,
+    UPROC_OP_READ,
+    UPROC_OP_READDIR,
+    UPROC_OP_WRITE,
+    UPROC_OP_MAX
+} uproc_op_t;
+
+/*
+* Cost of the handlers of an entry, kept by every file entry once the stats are enabled.
+* A handler call is a read_proc slice, a render or a write_proc call, cached reads cost nothing.
+*/
+typedef struct uproc_cost {
+    uint64_t reads;     // read and render handler calls
+    uint64_t writes;    // write handler calls
+    uint64_t bytes;     // rendered by the read handlers
+    uint64_t cpu_ns;    // CPU time of the calling thread spent in the handlers
+    uint64_t max_ns;    // CPU time of the most expensive call
+} uproc_cost_t;
+
+typedef struct uproc_stats {
+    uproc_hist_t    *ops[UPROC_OP_MAX]; // latency of the operations, in nanoseconds
+    uproc_counter_t *busy_ns;           // time spent serving the operations
+    uint64_t         handles;           // open file handles
+    uint64_t         buffer_bytes;      // held by the open handles
+} uproc_stats_t;
+
+/*
+* Makes the readonly "/.uproc" directory, where uproc exports its own internals:
+*   ops/<op>        latency histogram of every FUSE operation, see uproc_create_entry_hist()
+*   busy_ns         time spent serving operations, summed over the threads of the loop
+*   handles         open file handles
+*   buffer_bytes    memory held by the open handles
+*   htable          buckets, load factor and longest chain of the dentry hash table
+*   dentries        number of entries and bytes used by them
+*   top             the UPROC_STATS_TOP entries whose handlers cost the most CPU time,
+*                   one "path cpu_ns N max_ns N reads N writes N bytes N" line each, see uproc_cost_t
+* Operations are only timed if this is called before uproc_run().
+* returns 0 on success, otherwise a negative error code:
+*   -EEXIST           the stats are enabled already, or "/.uproc" is taken by another entry
+*   -ENOMEM           nothing was added to the tree
+*   -ENOTRECOVERABLE  ran out of memory halfway, "/.uproc" stays in the tree with
+*                     what was made of it, and the stats can't be enabled on @ctx any more
+*/
+#define UPROC_STATS_NAME        ".uproc"
+#define UPROC_STATS_TOP         20
+int uproc_enable_stats(uproc_ctx_t *ctx);
+
+/*
+* Makes a readonly "/metrics" file which renders the tree in the OpenMetrics text format,
+* for Prometheus to scrape in one read.
+* Numeric wrappers are exported as gauges, counters as counters and histograms as summaries,
+* entries with custom handlers are left out.
+* A metric is named after the path of its entry, '/' and other characters
+* Prometheus does not allow become '_', e.g. "net/eth0/rx" is "@prefix_net_eth0_rx".
+* Paths which end up with the same name, e.g. "a-b" and "a_b", are told apart by a
+* "_2", "_3"... suffix on the name of the ones scraped later.
+* Names are built once per entry and cached, a scrape only formats the values.
+* @prefix: prepended to every metric name, may be NULL.
+* returns 0 on success, -EEXIST if the metrics are enabled already,
+* otherwise a negative error code.
+*/
+#define UPROC_METRICS_NAME      "metrics"
+int uproc_enable_metrics(uproc_ctx_t *ctx, const char *prefix);
+
+/*
+* Publishes @len bytes of @data as the content of @entry.
+* The bytes are copied into an immutable buffer which replaces the previous one atomically,
+* reads are served from it without calling any handler, so the program decides
+* when its values are rendered and is never called from the uproc threads.
+* A read which is in progress keeps the buffer it started with.
+* returns 0 on success, otherwise a negative error code.
+*/
+int uproc_publish(uproc_dentry_t *entry, const void *data, size_t len);
+
+/*
+* Make an entry whose content is only ever published with uproc_publish(),
+* it reads as empty until the first publication.
+*/
+uproc_dentry_t* uproc_create_entry_publish(uproc_ctx_t *ctx,
+                                           const char *name, // name of the entry
+                                           mode_t mode,      // permissions
+                                           uproc_dentry_t* parent);
+
+/*
+* Renders @entry into @mem from within the program, the way a read(2) of
+* at most @size bytes at offset 0 of the entry would.
+* returns the number of bytes rendered, otherwise a negative error code.
+*/
+int uproc_read_entry(uproc_dentry_t *entry, char *mem, size_t size);
+
+/*
+* Caches the content of @entry for @ttl_ms milliseconds, meant for handlers
+* which are expensive to run. Reads within the TTL are served from the copy
+* rendered last, without calling the handler, no matter how many readers there are.
+* A write through uproc invalidates the copy, a @ttl_ms of 0 disables the cache.
+* The TTL may be changed while the entry is read, the copy is kept until uproc_destroy().
+* Renders of cached entries are single-flight, see uproc_entry_set_single_flight().
+* returns 0 on success, otherwise a negative error code.
+*/
+int uproc_entry_set_cache_ttl(uproc_dentry_t *entry, unsigned ttl_ms);
+
+/* Drops the cached content of @entry, the next read calls the handler again */
+void uproc_entry_invalidate(uproc_dentry_t *entry);
+
+/*
+* Makes concurrent reads of @entry share one call of its handler:
+* while the content is being rendered for one reader, other readers wait
+* for it and get the same bytes. Readers arriving afterwards render again,
+* unless a cache TTL is set as well.
+* returns 0 on success, otherwise a negative error code.
+*/
+int uproc_entry_set_single_flight(uproc_dentry_t *entry);
+
+/*
+* Makes the writes to a handle of @entry accumulate until the handle is closed,
+* then reach the write handler once, as one buffer at offset 0.
+* A value written in several chunks or write() calls is thus parsed once, as a whole,
+* and an error of the handler is returned by close().
+* Writes beyond the size of @entry fail with EFBIG.
+* returns 0 on success, otherwise a negative error code.
+*/
+int uproc_entry_set_assembled(uproc_dentry_t *entry);
+
+/*
+* Guards the values rendered by @entry with the seqlock @sl.
+* If @entry is a directory, every entry below it is guarded,
+* unless it has a seqlock of its own.
+* Reads of a guarded entry are rendered again until no writer updated
+* the group in the meantime, so handlers may be called more than once per read.
+*/
+void uproc_entry_set_seqlock(uproc_dentry_t *entry, uproc_seqlock_t *sl);
+
+/* the seqlock guarding @entry, NULL if none */
+uproc_seqlock_t* uproc_entry_seqlock(uproc_dentry_t *entry);
+
+/*
+* Declares that the program's writers of the seqlock of @entry hold @lock
+* around their write sections, so that uproc can update the group too:
+* uproc_apply() takes @lock and then writes the group as one more writer.
+* Writers keep using uproc_write_seqbegin(), they only wait while a batch is stored.
+* uproc_apply() refuses entries guarded by a seqlock whose writers declared no lock.
+*/
+void uproc_entry_set_writer_lock(uproc_dentry_t *entry, pthread_mutex_t *lock);
+
+/* the writer lock declared along with the seqlock guarding @entry, NULL if none */
+pthread_mutex_t* uproc_entry_writer_lock(uproc_dentry_t *entry);
+
 /*
 * Wrappers for primitive types.
 * @readonly: if set, only the default read hanlder will be installed.
@@ -328,6 +857,116 @@ uproc_dentry_t* uproc_create_entry_string(uproc_ctx_t *ctx,
                                            char *v
                                            );
 
+// wrapper for uproc_counter_t, it's readonly by definition.
+// Renders the sum of all the per-thread slots of @c.
+uproc_dentry_t* uproc_create_entry_counter(uproc_ctx_t *ctx,
+                                           const char *name, // name of the entry
+                                           mode_t mode,      // permissions
+                                           uproc_dentry_t* parent,
+                                           uproc_counter_t *c
+                                           );
+
+// wrapper for uproc_hist_t, it's readonly by definition.
+// Renders count, min, max, mean and p50/p90/p99/p999 as "key value" lines.
+uproc_dentry_t* uproc_create_entry_hist(uproc_ctx_t *ctx,
+                                        const char *name, // name of the entry
+                                        mode_t mode,      // permissions
+                                        uproc_dentry_t* parent,
+                                        uproc_hist_t *h
+                                        );
+
+/*
+* Describes a field of a struct to export, see UPROC_FIELD().
+* Only the primitive types (UPROC_TYPE_UCHAR to UPROC_TYPE_INT64) are supported.
+*/
+typedef struct uproc_field {
+    const char   *name;
+    uproc_type_t  type;
+    size_t        offset;
+} uproc_field_t;
+
+#define UPROC_FIELD(type, s, member) { #member, (type), offsetof(s, member) }
+
+/*
+* Exports a whole struct in one readonly entry.
+* Every field is rendered as a "name value" line, so a single read returns all of them.
+* @base: address of the struct.
+* @fields: descriptors of the fields to export, copied by uproc.
+*
+* example:
+    struct stats { uint64_t bytes; uint64_t packets; double load; } st;
+    uproc_field_t fields[] = {
+        UPROC_FIELD(UPROC_TYPE_UINT64, struct stats, bytes),
+        UPROC_FIELD(UPROC_TYPE_UINT64, struct stats, packets),
+        UPROC_FIELD(UPROC_TYPE_DOUBLE, struct stats, load),
+    };
+    uproc_create_entry_struct(ctx, "stats", 0, NULL, &st, fields, 3);
+*/
+uproc_dentry_t* uproc_create_entry_struct(uproc_ctx_t *ctx,
+                                          const char *name, // name of the entry
+                                          mode_t mode,      // permissions
+                                          uproc_dentry_t* parent,
+                                          void *base,
+                                          const uproc_field_t *fields,
+                                          size_t nfields
+                                          );
+
+/*
+* Exports a struct as a directory with one entry per field,
+* the per-field counterpart of uproc_create_entry_struct().
+* @mode: permissions of the field entries.
+* @readonly: if set, only the default read hanlder will be installed.
+* returns the directory.
+*/
+uproc_dentry_t* uproc_mkdir_struct(uproc_ctx_t *ctx,
+                                   const char *name, // name of the directory
+                                   mode_t mode,      // permissions of the field entries
+                                   uproc_dentry_t* parent,
+                                   int readonly,
+                                   void *base,
+                                   const uproc_field_t *fields,
+                                   size_t nfields
+                                   );
+
+/*
+* Rate entries, computed from a monotonic counter every time the entry is read.
+* Renders "rate", the per-second rate of change, "delta", the increase and
+* "interval_ms", the time the two are measured over, as "key value" lines.
+* @window_ms: if 0, rate and delta are computed since the previous read of the entry,
+*             otherwise over (at least) the last @window_ms milliseconds.
+*             Reads within 10 ms of the one that took the newest sample repeat its
+*             measurement instead of taking a sample of their own.
+*/
+uproc_dentry_t* uproc_create_entry_rate(uproc_ctx_t *ctx,
+                                        const char *name, // name of the entry
+                                        mode_t mode,      // permissions
+                                        uproc_dentry_t* parent,
+                                        unsigned window_ms,
+                                        const uint64_t *v
+                                        );
+
+uproc_dentry_t* uproc_create_entry_counter_rate(uproc_ctx_t *ctx,
+                                                const char *name, // name of the entry
+                                                mode_t mode,      // permissions
+                                                uproc_dentry_t* parent,
+                                                unsigned window_ms,
+                                                uproc_counter_t *c
+                                                );
+
+/*
+* Bounded numeric parsers for use in write handlers.
+* They parse (@s, @len) in place, so @s need not be null-terminated,
+* e.g. uproc_parse_int(buf->mem, buf->size, INT_MIN, INT_MAX, &x).
+* Leading and trailing whitespace is skipped, any other trailing character is an error.
+* returns 0 on success and stores the value in @v,
+* -EINVAL if @s does not hold a number, -ERANGE if the value is out of range.
+*/
+int uproc_parse_uint(const char *s, size_t len, uint64_t max, uint64_t *v);
+int uproc_parse_int(const char *s, size_t len, int64_t min, int64_t max, int64_t *v);
+int uproc_parse_float(const char *s, size_t len, float *v);
+int uproc_parse_double(const char *s, size_t len, double *v);
+int uproc_parse_ldouble(const char *s, size_t len, long double *v);
+
 #ifdef _UPROC_TEST
 int uproc_errno();
 #endif
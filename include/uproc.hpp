@@ -0,0 +1,312 @@
+#ifndef _UPROC_UPROC_HPP_
+#define _UPROC_UPROC_HPP_
+/*
+* Header-only C++17 binding on top of uproc.h.
+*
+*   uproc::expose(ctx, "conns", conns);                  // T& -> readable/writable entry
+*   uproc::expose(ctx, "limit", static_cast<const int&>(limit)); // const T& -> readonly entry
+*   uproc::entry(ctx, "qlen", [&] { return q.size(); }); // getter -> readonly entry
+*   uproc::entry(ctx, "level",                           // getter + setter
+*                [&] { return level; },
+*                [&](int v) { level = v; });
+*
+* Formatting and parsing are picked at compile time from the value type,
+* so each exported variable gets its own handler instead of the generic
+* type-erased ones in utility.c. Callables are stored as their own closure
+* type: captureless lambdas need no storage at all (C++20, where they are
+* default constructible), anything else is copied once into an allocation
+* released together with the entry.
+*/
+#include "uproc.h"
+
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace uproc {
+
+namespace detail {
+
+template <typename T>
+inline constexpr bool is_char_v = std::is_same_v<T, char> ||
+                                  std::is_same_v<T, signed char> ||
+                                  std::is_same_v<T, unsigned char>;
+
+template <typename T>
+inline constexpr bool is_value_v = std::is_arithmetic_v<T>;
+
+// terminate the rendered value with '\n' the same way the C wrappers do.
+inline int finish_line(uproc_buf_t *buf, int n) {
+    if (n > 0) {
+        if ((size_t)n >= buf->size) {
+            buf->mem[buf->size - 1] = '\n';
+        } else {
+            buf->mem[n] = '\n';
+            ++n;
+        }
+    }
+    return n;
+}
+
+template <typename T>
+inline int format(uproc_buf_t *buf, const T &v) {
+    static_assert(is_value_v<T>, "uproc: only arithmetic types can be exported");
+    int n;
+
+    if (buf->size == 0)
+        return 0;
+    if constexpr (std::is_same_v<T, bool>) {
+        buf->mem[0] = v ? '1' : '0';
+        n = 1;
+    } else if constexpr (is_char_v<T>) {
+        buf->mem[0] = (char)v;
+        n = 1;
+    } else if constexpr (std::is_integral_v<T>) {
+        std::to_chars_result r = std::to_chars(buf->mem, buf->mem + buf->size, v);
+        // like snprintf(), a value that does not fit is truncated
+        n = r.ec == std::errc() ? (int)(r.ptr - buf->mem) : (int)buf->size;
+    } else if constexpr (std::is_same_v<T, long double>) {
+        n = snprintf(buf->mem, buf->size, "%Lf", v);
+    } else {
+        n = snprintf(buf->mem, buf->size, "%f", (double)v);
+    }
+    return finish_line(buf, n);
+}
+
+template <typename T>
+inline int parse(const char *s, size_t len, T &v) {
+    static_assert(is_value_v<T>, "uproc: only arithmetic types can be exported");
+    int ret;
+
+    if constexpr (std::is_same_v<T, bool>) {
+        uint64_t x;
+        if ((ret = uproc_parse_uint(s, len, 1, &x)))
+            return ret;
+        v = x != 0;
+    } else if constexpr (is_char_v<T>) {
+        if (len == 0)
+            return -EINVAL;
+        v = (T)s[0];
+    } else if constexpr (std::is_integral_v<T> && std::is_unsigned_v<T>) {
+        uint64_t x;
+        if ((ret = uproc_parse_uint(s, len, std::numeric_limits<T>::max(), &x)))
+            return ret;
+        v = (T)x;
+    } else if constexpr (std::is_integral_v<T>) {
+        int64_t x;
+        if ((ret = uproc_parse_int(s, len, std::numeric_limits<T>::min(),
+                                   std::numeric_limits<T>::max(), &x)))
+            return ret;
+        v = (T)x;
+    } else if constexpr (std::is_same_v<T, float>) {
+        return uproc_parse_float(s, len, &v);
+    } else if constexpr (std::is_same_v<T, double>) {
+        return uproc_parse_double(s, len, &v);
+    } else {
+        return uproc_parse_ldouble(s, len, &v);
+    }
+    return 0;
+}
+
+// uproc_type_t of a variable of type T, UPROC_TYPE_NONE if it has none (bool).
+template <typename T>
+constexpr uproc_type_t type_of() {
+    if constexpr (std::is_same_v<T, char> || std::is_same_v<T, signed char>)
+        return UPROC_TYPE_CHAR;
+    else if constexpr (std::is_same_v<T, unsigned char>)
+        return UPROC_TYPE_UCHAR;
+    else if constexpr (std::is_same_v<T, short>)
+        return UPROC_TYPE_SHORT;
+    else if constexpr (std::is_same_v<T, unsigned short>)
+        return UPROC_TYPE_USHORT;
+    else if constexpr (std::is_same_v<T, int>)
+        return UPROC_TYPE_INT;
+    else if constexpr (std::is_same_v<T, unsigned int>)
+        return UPROC_TYPE_UINT;
+    else if constexpr (std::is_same_v<T, long>)
+        return UPROC_TYPE_LONG;
+    else if constexpr (std::is_same_v<T, unsigned long>)
+        return UPROC_TYPE_ULONG;
+    else if constexpr (std::is_same_v<T, long long>)
+        return UPROC_TYPE_LLONG;
+    else if constexpr (std::is_same_v<T, unsigned long long>)
+        return UPROC_TYPE_ULLONG;
+    else if constexpr (std::is_same_v<T, float>)
+        return UPROC_TYPE_FLOAT;
+    else if constexpr (std::is_same_v<T, double>)
+        return UPROC_TYPE_DOUBLE;
+    else if constexpr (std::is_same_v<T, long double>)
+        return UPROC_TYPE_LDOUBLE;
+    else
+        return UPROC_TYPE_NONE;
+}
+
+inline size_t write_size(const uproc_buf_t *buf) {
+    return buf->size > buf->entry->size ? buf->entry->size : buf->size;
+}
+
+template <typename T>
+int read_var(uproc_buf_t *buf, int *done, off_t, void *private_data) {
+    *done = 1;
+    return format(buf, *static_cast<const T *>(private_data));
+}
+
+template <typename T>
+int write_var(uproc_buf_t *buf, int *done, off_t, void *private_data) {
+    T x;
+    int ret;
+
+    *done = 1;
+    if ((ret = parse(buf->mem, write_size(buf), x)))
+        return ret;
+    *static_cast<T *>(private_data) = x;
+    return (int)buf->size;
+}
+
+/*
+* Captureless lambdas are empty and default constructible (C++20),
+* those are rebuilt on the spot instead of being stored.
+*/
+template <typename F>
+inline constexpr bool is_stateless_v = std::is_empty_v<F> &&
+                                       std::is_default_constructible_v<F>;
+
+template <typename G, typename S>
+struct binding {
+    G get;
+    S set;
+};
+
+template <typename B>
+inline constexpr bool is_stateless_binding_v = false;
+
+template <typename G, typename S>
+inline constexpr bool is_stateless_binding_v<binding<G, S>> = is_stateless_v<G> &&
+                                                              is_stateless_v<S>;
+
+template <typename B>
+inline B &unwrap(void *private_data) {
+    if constexpr (is_stateless_binding_v<B>) {
+        static B b{};
+        return b;
+    } else {
+        return *static_cast<B *>(private_data);
+    }
+}
+
+template <typename B>
+int read_binding(uproc_buf_t *buf, int *done, off_t, void *private_data) {
+    *done = 1;
+    return format(buf, unwrap<B>(private_data).get());
+}
+
+template <typename B, typename T>
+int write_binding(uproc_buf_t *buf, int *done, off_t, void *private_data) {
+    T x;
+    int ret;
+
+    *done = 1;
+    if ((ret = parse(buf->mem, write_size(buf), x)))
+        return ret;
+    unwrap<B>(private_data).set(std::move(x));
+    return (int)buf->size;
+}
+
+template <typename B>
+void free_binding(void *private_data) {
+    delete static_cast<B *>(private_data);
+}
+
+struct no_setter {
+    template <typename T>
+    void operator()(T &&) const {}
+};
+
+template <typename G, typename S>
+uproc_dentry_t *make_entry(uproc_ctx_t *ctx, const char *path, G &&get, S &&set,
+                           mode_t mode, uproc_dentry_t *parent) {
+    typedef binding<std::decay_t<G>, std::decay_t<S>> B;
+    typedef std::decay_t<std::invoke_result_t<std::decay_t<G> &>> T;
+    static_assert(is_value_v<T>, "uproc: the getter must return an arithmetic type");
+    uproc_write_proc_t write_proc = nullptr;
+    uproc_dentry_t *ent;
+    B *b = nullptr;
+
+    if constexpr (!std::is_same_v<std::decay_t<S>, no_setter>) {
+        static_assert(std::is_invocable_v<std::decay_t<S> &, T>,
+                      "uproc: the setter must accept the getter's return type");
+        write_proc = write_binding<B, T>;
+    }
+    if constexpr (!is_stateless_binding_v<B>) {
+        b = new (std::nothrow) B{std::forward<G>(get), std::forward<S>(set)};
+        if (!b)
+            return nullptr;
+    }
+
+    ent = uproc_entry_prepare(ctx, path, mode, 4096, parent, read_binding<B>,
+                              write_proc, b);
+    if (ent && b)
+        ent->free_proc = free_binding<B>;
+    if (!ent || uproc_entry_commit(ctx, ent)) {
+        delete b;
+        return nullptr;
+    }
+    return ent;
+}
+
+} // namespace detail
+
+/*
+* Export variable @v under @path.
+* The entry is readonly if @v is const-qualified.
+* @v must outlive the uproc context.
+*/
+template <typename T>
+uproc_dentry_t *expose(uproc_ctx_t *ctx, const char *path, T &v,
+                       mode_t mode = 0, uproc_dentry_t *parent = nullptr) {
+    typedef std::remove_cv_t<T> V;
+    static_assert(detail::is_value_v<V>, "uproc: only arithmetic types can be exported");
+    uproc_write_proc_t write_proc = nullptr;
+
+    uproc_dentry_t *ent;
+
+    if constexpr (!std::is_const_v<T>)
+        write_proc = detail::write_var<V>;
+    ent = uproc_entry_prepare(ctx, path, mode, 4096, parent, detail::read_var<V>,
+                              write_proc, (void *)&v);
+    if (!ent)
+        return nullptr;
+    // lets the binary view read the variable as is
+    ent->type = detail::type_of<V>();
+    return uproc_entry_commit(ctx, ent) ? nullptr : ent;
+}
+
+/*
+* Export the value returned by @get under @path, readonly.
+*/
+template <typename G>
+uproc_dentry_t *entry(uproc_ctx_t *ctx, const char *path, G &&get,
+                      mode_t mode = 0, uproc_dentry_t *parent = nullptr) {
+    return detail::make_entry(ctx, path, std::forward<G>(get), detail::no_setter(),
+                              mode, parent);
+}
+
+/*
+* Export the value returned by @get under @path,
+* writes are parsed as the getter's return type and passed to @set.
+*/
+template <typename G, typename S,
+          typename = std::enable_if_t<!std::is_arithmetic_v<std::decay_t<S>>>>
+uproc_dentry_t *entry(uproc_ctx_t *ctx, const char *path, G &&get, S &&set,
+                      mode_t mode = 0, uproc_dentry_t *parent = nullptr) {
+    return detail::make_entry(ctx, path, std::forward<G>(get), std::forward<S>(set),
+                              mode, parent);
+}
+
+} // namespace uproc
+
+#endif
@@ -0,0 +1,302 @@
+#include <uproc.h>
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <ctype.h>
+
+/*
+* Bulk files render a whole subtree in one stream,
+* walking the children of their directory and rendering every readable entry in place.
+*/
+
+typedef struct {
+    uproc_dentry_t *dir;
+    int             format;
+} __bulk_t;
+
+/* state of one rendering of a bulk file */
+typedef struct {
+    int             format;
+    uproc_strbuf_t *out;
+    uproc_strbuf_t  path;    // path of the current entry, relative to the bulk file
+    uproc_strbuf_t  val;     // scratch space for the values
+    size_t          nvalues;
+} __bulk_walk_t;
+
+static int __json_escape(uproc_strbuf_t *out, const char *s, size_t len) {
+    const char *hex = "0123456789abcdef";
+    size_t i, start = 0;
+    char esc[6] = { '\\', 'u', '0', '0' };
+    unsigned char c;
+
+    for (i = 0; i < len; ++i) {
+        c = s[i];
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+        if (uproc_strbuf_append(out, s + start, i - start))
+            return -ENOMEM;
+        start = i + 1;
+        switch (c) {
+        case '"':  if (uproc_strbuf_append(out, "\\\"", 2)) return -ENOMEM; break;
+        case '\\': if (uproc_strbuf_append(out, "\\\\", 2)) return -ENOMEM; break;
+        case '\n': if (uproc_strbuf_append(out, "\\n", 2)) return -ENOMEM; break;
+        case '\t': if (uproc_strbuf_append(out, "\\t", 2)) return -ENOMEM; break;
+        default:
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 0xf];
+            if (uproc_strbuf_append(out, esc, 6))
+                return -ENOMEM;
+        }
+    }
+    return uproc_strbuf_append(out, s + start, len - start);
+}
+
+/* "path line" for every line of @val */
+static int __bulk_emit_text(__bulk_walk_t *w, const char *val, size_t len) {
+    uproc_strbuf_t *out = w->out;
+    const char *nl;
+
+    do {
+        nl = memchr(val, '\n', len);
+        if (uproc_strbuf_append(out, w->path.data, w->path.len) ||
+            uproc_strbuf_append(out, " ", 1) ||
+            uproc_strbuf_append(out, val, nl ? nl - val : len) ||
+            uproc_strbuf_append(out, "\n", 1))
+            return -ENOMEM;
+        if (nl) {
+            len -= nl + 1 - val;
+            val = nl + 1;
+        }
+    } while (nl && len);
+    return 0;
+}
+
+static int __bulk_emit_json(__bulk_walk_t *w, const char *val, size_t len) {
+    uproc_strbuf_t *out = w->out;
+
+    if (uproc_strbuf_append(out, w->nvalues ? ",\n\"" : "\n\"", w->nvalues ? 3 : 2) ||
+        __json_escape(out, w->path.data, w->path.len) ||
+        uproc_strbuf_append(out, "\": \"", 4) ||
+        __json_escape(out, val, len) ||
+        uproc_strbuf_append(out, "\"", 1))
+        return -ENOMEM;
+    return 0;
+}
+
+/* entries without a binary form are left out */
+static int __bulk_emit_binary(__bulk_walk_t *w, uproc_dentry_t *p) {
+    uproc_strbuf_t *out = w->out;
+    size_t len = out->len;
+    unsigned char hdr[2];
+    int ret;
+
+    if (w->path.len > UINT16_MAX)
+        return 0;
+    hdr[0] = w->path.len & 0xff;
+    hdr[1] = w->path.len >> 8;
+    if (uproc_strbuf_append(out, (char*)hdr, 2) ||
+        uproc_strbuf_append(out, w->path.data, w->path.len))
+        return -ENOMEM;
+    if ((ret = uproc_render_entry_binary(p, out))) {
+        out->len = len;
+        return ret == -ENOMEM ? ret : 0;
+    }
+    return 0;
+}
+
+/* Renders the subtree of @dir, w->path holds the path of @dir */
+static int __bulk_walk(__bulk_walk_t *w, uproc_dentry_t *dir) {
+    uproc_dentry_t *p;
+    size_t plen = w->path.len, len;
+    int ret;
+
+    for (p = uproc_dentry_children(dir); p; p = p->next) {
+        if (p->flags & UPROC_DENTRY_VIRTUAL)
+            continue;
+        if (!S_ISDIR(p->mode) && !p->read_proc && !p->render_proc && !p->async_proc &&
+            !__atomic_load_n(&p->published, __ATOMIC_RELAXED))
+            continue;
+
+        w->path.len = plen;
+        if (uproc_strbuf_append(&w->path, p->name, p->namelen))
+            return -ENOMEM;
+
+        if (S_ISDIR(p->mode)) {
+            if (uproc_strbuf_append(&w->path, "/", 1))
+                return -ENOMEM;
+            if ((ret = __bulk_walk(w, p)))
+                return ret;
+            continue;
+        }
+
+        if (w->format == UPROC_BULK_BINARY) {
+            if ((ret = __bulk_emit_binary(w, p)))
+                return ret;
+            continue;
+        }
+
+        w->val.len = 0;
+        // an entry that fails to render is left out, the rest of the subtree is still useful
+        if (uproc_render_entry(p, &w->val))
+            continue;
+        len = w->val.len;
+        if (len && w->val.data[len - 1] == '\n')
+            --len;
+
+        if (w->format == UPROC_BULK_JSON)
+            ret = __bulk_emit_json(w, w->val.data, len);
+        else
+            ret = __bulk_emit_text(w, w->val.data, len);
+        if (ret)
+            return ret;
+        ++w->nvalues;
+    }
+    w->path.len = plen;
+    return 0;
+}
+
+static int __bulk_render_proc(uproc_strbuf_t *out, void *private_data) {
+    __bulk_t *bk = (__bulk_t *)private_data;
+    __bulk_walk_t w;
+    int ret;
+
+    memset(&w, 0, sizeof(w));
+    w.format = bk->format;
+    w.out = out;
+
+    if (w.format == UPROC_BULK_JSON && uproc_strbuf_append(out, "{", 1))
+        return -ENOMEM;
+    ret = __bulk_walk(&w, bk->dir);
+    if (!ret && w.format == UPROC_BULK_JSON)
+        ret = uproc_strbuf_append(out, "\n}\n", 3);
+
+    uproc_strbuf_free(&w.path);
+    uproc_strbuf_free(&w.val);
+    return ret;
+}
+
+uproc_dentry_t* uproc_create_entry_bulk(uproc_ctx_t *ctx,
+                                        const char *name,
+                                        uproc_dentry_t *dir,
+                                        int format) {
+    uproc_dentry_t *ent;
+    __bulk_t *bk;
+
+    if (!ctx)
+        return NULL;
+    if (format != UPROC_BULK_TEXT && format != UPROC_BULK_JSON && format != UPROC_BULK_BINARY) {
+        if (ctx->dbg)
+            fprintf(stderr, "uproc: invalid bulk format %d\n", format);
+        return NULL;
+    }
+    if (!dir)
+        dir = ctx->root;
+    if (!name)
+        name = format == UPROC_BULK_JSON ? UPROC_BULK_JSON_NAME :
+               format == UPROC_BULK_BINARY ? UPROC_BULK_BINARY_NAME : UPROC_BULK_TEXT_NAME;
+
+    bk = malloc(sizeof(*bk));
+    if (!bk) {
+        if (ctx->dbg)
+            fprintf(stderr, "uproc: memory shortage, can't allocate bulk state for \"%s\"\n", name);
+        return NULL;
+    }
+    bk->dir = dir;
+    bk->format = format;
+
+    ent = uproc_entry_prepare(ctx, name, S_IRUSR | S_IRGRP | S_IROTH, 0, dir,
+                              NULL, NULL, (void*)bk);
+    if (ent) {
+        ent->render_proc = __bulk_render_proc;
+        ent->free_proc = free;
+        ent->flags |= UPROC_DENTRY_VIRTUAL;
+    }
+    if (!ent || uproc_entry_commit(ctx, ent)) {
+        free(bk);
+        return NULL;
+    }
+    return ent;
+}
+
+int uproc_enable_bulk(uproc_ctx_t *ctx, int formats) {
+    int f;
+
+    if (!ctx || (formats & ~(UPROC_BULK_TEXT | UPROC_BULK_JSON | UPROC_BULK_BINARY)))
+        return -EINVAL;
+
+    for (f = UPROC_BULK_TEXT; f <= UPROC_BULK_BINARY; f <<= 1) {
+        if ((formats & f) && !uproc_create_entry_bulk(ctx, NULL, ctx->root, f))
+            return -ENOMEM;
+    }
+    ctx->bulk = formats;
+    return 0;
+}
+
+/*
+* The query file answers a list of paths with the same "path value" lines
+* as a text bulk file, in the order the paths were asked for.
+*/
+int uproc_query(uproc_ctx_t *ctx, const char *paths, size_t len, uproc_strbuf_t *out) {
+    const char *p = paths, *end = paths + len, *nl, *e;
+    uproc_dentry_t *ent;
+    __bulk_walk_t w;
+    size_t vlen;
+    int ret = 0;
+
+    memset(&w, 0, sizeof(w));
+    w.format = UPROC_BULK_TEXT;
+    w.out = out;
+
+    for (; p < end && !ret; p = nl + 1) {
+        nl = memchr(p, '\n', end - p);
+        if (!nl)
+            nl = end;
+        // trim whitespace, blank lines are skipped
+        for (e = nl; e > p && isspace((unsigned char)e[-1]); --e)
+            ;
+        while (p < e && isspace((unsigned char)*p))
+            ++p;
+        if (p == e)
+            continue;
+
+        w.path.len = 0;
+        if (uproc_strbuf_append(&w.path, p, e - p) || uproc_strbuf_append(&w.path, "", 1)) {
+            ret = -ENOMEM;
+            break;
+        }
+        --w.path.len;
+
+        w.val.len = 0;
+        ent = uproc_lookup(ctx, w.path.data);
+        ret = ent ? uproc_render_entry(ent, &w.val) : -ENOENT;
+        if (ret == -ENOMEM)
+            break;
+        if (ret) {
+            ret = uproc_strbuf_printf(out, "%s !%s\n", w.path.data, strerror(-ret));
+            continue;
+        }
+
+        vlen = w.val.len;
+        if (vlen && w.val.data[vlen - 1] == '\n')
+            --vlen;
+        ret = __bulk_emit_text(&w, w.val.data, vlen);
+    }
+
+    uproc_strbuf_free(&w.path);
+    uproc_strbuf_free(&w.val);
+    return ret;
+}
+
+int uproc_enable_query(uproc_ctx_t *ctx) {
+    uproc_dentry_t *ent;
+
+    if (!ctx)
+        return -EINVAL;
+    ent = uproc_entry_prepare(ctx, UPROC_QUERY_NAME, S_IRUSR | S_IRGRP | S_IROTH |
+                              S_IWUSR | S_IWGRP | S_IWOTH, 0, ctx->root, NULL, NULL, (void*)ctx);
+    if (!ent)
+        return -ENOMEM;
+    ent->flags |= UPROC_DENTRY_VIRTUAL | UPROC_DENTRY_QUERY;
+    return uproc_entry_commit(ctx, ent) ? -ENOMEM : 0;
+}
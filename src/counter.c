@@ -0,0 +1,107 @@
+#include <uproc.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+
+__thread int __uproc_thread_slot;
+
+/*
+* Slots handed back by exited threads. A slot is owned by at most one thread
+* at a time, so reusing it keeps the values it accumulated intact.
+*/
+static pthread_mutex_t __slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static int             __slot_free[UPROC_COUNTER_NSLOTS];
+static int             __slot_nfree;
+static int             __slot_next;
+static pthread_key_t   __slot_key;
+static pthread_once_t  __slot_once = PTHREAD_ONCE_INIT;
+
+static void __uproc_thread_slot_release(void *data) {
+    int s = (int)(intptr_t)data - 1;
+
+    pthread_mutex_lock(&__slot_lock);
+    __slot_free[__slot_nfree++] = s;
+    pthread_mutex_unlock(&__slot_lock);
+}
+
+static void __uproc_thread_slot_init(void) {
+    pthread_key_create(&__slot_key, __uproc_thread_slot_release);
+}
+
+int __uproc_thread_slot_alloc(void) {
+    int s;
+
+    pthread_once(&__slot_once, __uproc_thread_slot_init);
+
+    pthread_mutex_lock(&__slot_lock);
+    if (__slot_nfree > 0) {
+        s = __slot_free[--__slot_nfree];
+    } else if (__slot_next < UPROC_COUNTER_NSLOTS) {
+        s = __slot_next++;
+    } else {
+        s = UPROC_COUNTER_NSLOTS;
+    }
+    pthread_mutex_unlock(&__slot_lock);
+
+    // only real slots are given back at thread exit
+    if (s < UPROC_COUNTER_NSLOTS)
+        pthread_setspecific(__slot_key, (void*)(intptr_t)(s + 1));
+
+    __uproc_thread_slot = s + 1;
+    return __uproc_thread_slot;
+}
+
+void uproc_counter_init(uproc_counter_t *c) {
+    memset(c, 0, sizeof(*c));
+}
+
+uproc_counter_t* uproc_counter_alloc(void) {
+    void *p;
+
+    if (posix_memalign(&p, UPROC_CACHELINE_SIZE, sizeof(uproc_counter_t)))
+        return NULL;
+    uproc_counter_init((uproc_counter_t*)p);
+    return (uproc_counter_t*)p;
+}
+
+uint64_t uproc_counter_read(uproc_counter_t *c) {
+    uint64_t sum = 0;
+    int i;
+
+    for (i = 0; i < UPROC_COUNTER_NSLOTS; ++i)
+        sum += __atomic_load_n(&c->slots[i].v, __ATOMIC_RELAXED);
+    sum += __atomic_load_n(&c->overflow.v, __ATOMIC_RELAXED);
+    return sum;
+}
+
+static int __counter_read_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
+    uproc_counter_t *c = (uproc_counter_t *)private_data;
+    int n = snprintf(buf->mem, buf->size, "%llu", (unsigned long long)uproc_counter_read(c));
+    if (n > 0) {
+        if (n >= buf->size){
+            buf->mem[buf->size - 1] = '\n';
+        } else {
+            buf->mem[n] = '\n';
+            ++n;
+        }
+    }
+    *done = 1;
+    return n;
+}
+
+// wrapper for uproc_counter_t, it's readonly since only the owning threads may write the slots.
+uproc_dentry_t* uproc_create_entry_counter(uproc_ctx_t *ctx,
+                                           const char *name, // name of the entry
+                                           mode_t mode,      // permissions
+                                           uproc_dentry_t* parent,
+                                           uproc_counter_t *c
+                                           ) {
+    uproc_dentry_t *ent = uproc_entry_prepare(ctx, name, mode, 4096, parent,
+                                              __counter_read_proc, /* write_proc */ NULL, (void*)c);
+    if (!ent)
+        return NULL;
+    ent->type = UPROC_TYPE_COUNTER;
+    return uproc_entry_commit(ctx, ent) ? NULL : ent;
+}
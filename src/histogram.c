@@ -0,0 +1,159 @@
+#include <uproc.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+void uproc_hist_init(uproc_hist_t *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+void uproc_hist_destroy(uproc_hist_t *h) {
+    int i;
+
+    for (i = 0; i < UPROC_COUNTER_NSLOTS; ++i) {
+        free(h->shards[i]);
+        h->shards[i] = NULL;
+    }
+}
+
+uproc_hist_t* uproc_hist_alloc(void) {
+    void *p;
+
+    if (posix_memalign(&p, UPROC_CACHELINE_SIZE, sizeof(uproc_hist_t)))
+        return NULL;
+    uproc_hist_init((uproc_hist_t*)p);
+    return (uproc_hist_t*)p;
+}
+
+void uproc_hist_free(uproc_hist_t *h) {
+    if (h) {
+        uproc_hist_destroy(h);
+        free(h);
+    }
+}
+
+int uproc_hist_thread_prepare(uproc_hist_t *h) {
+    int slot = uproc_thread_slot();
+    void *p;
+
+    // only the thread owning @slot sets its shard
+    if (slot >= UPROC_COUNTER_NSLOTS || __atomic_load_n(&h->shards[slot], __ATOMIC_RELAXED))
+        return 0;
+    if (posix_memalign(&p, UPROC_CACHELINE_SIZE, sizeof(struct uproc_hist_shard)))
+        return -ENOMEM;
+    memset(p, 0, sizeof(struct uproc_hist_shard));
+    // snapshots see the shard zeroed
+    __atomic_store_n(&h->shards[slot], (struct uproc_hist_shard *)p, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* the highest value that falls into bucket @idx */
+static uint64_t __uproc_hist_bucket_high(unsigned idx) {
+    unsigned k = idx >> UPROC_HIST_SUB_BITS;
+    uint64_t sub = idx & (UPROC_HIST_SUB_COUNT - 1);
+    uint64_t low;
+
+    if (k == 0)
+        return idx;
+    low = (UPROC_HIST_SUB_COUNT + sub) << (k - 1);
+    return low + ((uint64_t)1 << (k - 1)) - 1;
+}
+
+void uproc_hist_snapshot(uproc_hist_t *h, uproc_hist_snapshot_t *snap) {
+    uint64_t min_inv = 0, max = 0, v;
+    int i, j;
+
+    memset(snap, 0, sizeof(*snap));
+    for (i = 0; i <= UPROC_COUNTER_NSLOTS; ++i) {
+        struct uproc_hist_shard *s = i < UPROC_COUNTER_NSLOTS ?
+                                     __atomic_load_n(&h->shards[i], __ATOMIC_ACQUIRE) : &h->overflow;
+        if (!s)
+            continue;
+        for (j = 0; j < UPROC_HIST_NBUCKETS; ++j) {
+            v = __atomic_load_n(&s->buckets[j], __ATOMIC_RELAXED);
+            snap->buckets[j] += v;
+            snap->count += v;
+        }
+        snap->sum += __atomic_load_n(&s->sum, __ATOMIC_RELAXED);
+        v = __atomic_load_n(&s->max, __ATOMIC_RELAXED);
+        if (v > max)
+            max = v;
+        v = __atomic_load_n(&s->min_inv, __ATOMIC_RELAXED);
+        if (v > min_inv)
+            min_inv = v;
+    }
+    if (snap->count) {
+        snap->min = ~min_inv;
+        snap->max = max;
+    }
+}
+
+uint64_t uproc_hist_percentile(const uproc_hist_snapshot_t *snap, double q) {
+    uint64_t rank, seen = 0, v;
+    unsigned i;
+
+    if (snap->count == 0)
+        return 0;
+    if (q < 0)
+        q = 0;
+    if (q > 1)
+        q = 1;
+    rank = (uint64_t)(q * snap->count);
+    if (rank < q * snap->count)
+        ++rank;
+    if (rank == 0)
+        rank = 1;
+
+    for (i = 0; i < UPROC_HIST_NBUCKETS; ++i) {
+        seen += snap->buckets[i];
+        if (seen >= rank)
+            break;
+    }
+
+    v = i < UPROC_HIST_NBUCKETS ? __uproc_hist_bucket_high(i) : snap->max;
+    if (v > snap->max)
+        v = snap->max;
+    if (v < snap->min)
+        v = snap->min;
+    return v;
+}
+
+static int __hist_read_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
+    uproc_hist_t *h = (uproc_hist_t *)private_data;
+    uproc_hist_snapshot_t snap;
+    int n;
+
+    uproc_hist_snapshot(h, &snap);
+    n = snprintf(buf->mem, buf->size,
+                 "count %llu\nmin %llu\nmax %llu\nmean %.3f\n"
+                 "p50 %llu\np90 %llu\np99 %llu\np999 %llu\n",
+                 (unsigned long long)snap.count,
+                 (unsigned long long)snap.min,
+                 (unsigned long long)snap.max,
+                 snap.count ? (double)snap.sum / snap.count : 0.0,
+                 (unsigned long long)uproc_hist_percentile(&snap, 0.5),
+                 (unsigned long long)uproc_hist_percentile(&snap, 0.9),
+                 (unsigned long long)uproc_hist_percentile(&snap, 0.99),
+                 (unsigned long long)uproc_hist_percentile(&snap, 0.999));
+    if (n >= buf->size)
+        n = buf->size;
+    *done = 1;
+    return n;
+}
+
+// wrapper for uproc_hist_t, it's readonly by definition.
+uproc_dentry_t* uproc_create_entry_hist(uproc_ctx_t *ctx,
+                                        const char *name, // name of the entry
+                                        mode_t mode,      // permissions
+                                        uproc_dentry_t* parent,
+                                        uproc_hist_t *h
+                                        ) {
+    uproc_dentry_t *ent = uproc_entry_prepare(ctx, name, mode, 4096, parent,
+                                              __hist_read_proc, /* write_proc */ NULL, (void*)h);
+    if (!ent)
+        return NULL;
+    ent->type = UPROC_TYPE_HIST;
+    return uproc_entry_commit(ctx, ent) ? NULL : ent;
+}
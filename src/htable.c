@@ -168,4 +168,26 @@ struct hlist_node* uproc_htable_find(uproc_htable_t * ht, unsigned key,
 inline void uproc_htable_free(uproc_htable_t * ht){
     free(ht->buckets);
     memset(ht, 0, sizeof(uproc_htable_t));
-}
\ No newline at end of file
+}
+
+void uproc_htable_stats(uproc_htable_t *ht, uproc_htable_stats_t *st){
+    struct hlist_node *p;
+    int i, n;
+
+    st->len = ht->len;
+    st->n_entries = ht->n_entries;
+    st->used = 0;
+    st->max_chain = 0;
+    st->load = ht->len ? (double)ht->n_entries / ht->len : 0;
+
+    for(i = 0; i < ht->len; ++i){
+        n = 0;
+        hlist_for_each(p, &ht->buckets[i]){
+            ++n;
+        }
+        if(n)
+            ++st->used;
+        if(n > st->max_chain)
+            st->max_chain = n;
+    }
+}
@@ -0,0 +1,353 @@
+#include <uproc.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <math.h>
+#include <errno.h>
+#include <pthread.h>
+
+/*
+* The metrics file renders the tree in the OpenMetrics text format.
+* Every exported entry caches its "# TYPE" line and sample name in dentry->metric,
+* so a scrape only formats values.
+* Paths which sanitize to the same name get a "_2", "_3"... suffix in the order
+* they are first scraped, see __metric().
+*/
+
+typedef struct {
+    uproc_dentry_t *root;
+    char           *prefix; // with a trailing '_', "" if none
+    pthread_mutex_t lock;   // guards @names
+    uproc_htable_t  names;  // names handed out so far, of __metric_t
+} __metrics_t;
+
+/* cached exposition of a dentry */
+typedef struct {
+    struct hlist_node hlink;   // in __metrics_t.names
+    size_t hdrlen;  // length of the "# TYPE" line
+    size_t namelen;
+    char   text[];  // "# TYPE name kind\n" followed by name
+} __metric_t;
+
+static const double __quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+static int __is_signed(uproc_type_t type) {
+    switch (type) {
+    case UPROC_TYPE_CHAR:
+    case UPROC_TYPE_SHORT:
+    case UPROC_TYPE_INT:
+    case UPROC_TYPE_LONG:
+    case UPROC_TYPE_LLONG:
+    case UPROC_TYPE_INT16:
+    case UPROC_TYPE_INT32:
+    case UPROC_TYPE_INT64:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* appends the name of @entry below the root, sanitized for Prometheus */
+static int __append_name(uproc_strbuf_t *sb, uproc_dentry_t *entry) {
+    size_t i, start;
+
+    if (!entry->parent)
+        return 0;
+    if (__append_name(sb, entry->parent))
+        return -ENOMEM;
+    if (entry->parent->parent && uproc_strbuf_append(sb, "_", 1))
+        return -ENOMEM;
+
+    start = sb->len;
+    if (uproc_strbuf_append(sb, entry->name, entry->namelen))
+        return -ENOMEM;
+    for (i = start; i < sb->len; ++i) {
+        if (!isalnum((unsigned char)sb->data[i]) && sb->data[i] != '_' && sb->data[i] != ':')
+            sb->data[i] = '_';
+    }
+    return 0;
+}
+
+/* Jenkins' one-at-a-time hash function */
+static unsigned __name_hash(const char *name, size_t len) {
+    unsigned hash, i;
+
+    for (hash = i = 0; i < len; ++i) {
+        hash += (unsigned char)name[i];
+        hash += (hash << 10);
+        hash ^= (hash >> 6);
+    }
+    hash += (hash << 3);
+    hash ^= (hash >> 11);
+    hash += (hash << 15);
+    return hash;
+}
+
+static unsigned __metric_hash(struct hlist_node *p) {
+    __metric_t *mt = hlist_entry(p, __metric_t, hlink);
+
+    return __name_hash(mt->text + mt->hdrlen, mt->namelen);
+}
+
+static unsigned __metric_equal(struct hlist_node *p, void *name, void *len, void *unused) {
+    __metric_t *mt = hlist_entry(p, __metric_t, hlink);
+
+    return mt->namelen == (size_t)len && !memcmp(mt->text + mt->hdrlen, name, mt->namelen);
+}
+
+/* the sanitized name of @entry with the prefix, in @name */
+static int __metric_name(__metrics_t *m, uproc_dentry_t *entry, uproc_strbuf_t *name) {
+    uproc_strbuf_t path;
+    int ret = -ENOMEM;
+
+    memset(&path, 0, sizeof(path));
+    if (uproc_strbuf_append(&path, m->prefix, strlen(m->prefix)) ||
+        __append_name(&path, entry))
+        goto out;
+    if (!path.len) {
+        ret = -EINVAL;
+        goto out;
+    }
+    // a name can't start with a digit
+    if ((isdigit((unsigned char)path.data[0]) && uproc_strbuf_append(name, "_", 1)) ||
+        uproc_strbuf_append(name, path.data, path.len))
+        goto out;
+    ret = 0;
+out:
+    uproc_strbuf_free(&path);
+    return ret;
+}
+
+/*
+* Builds the exposition of @entry and hands its name out, @m->lock held.
+* A name already handed out to another entry gets the first free "_<n>" suffix.
+*/
+static __metric_t* __metric_build(__metrics_t *m, uproc_strbuf_t *name, const char *kind) {
+    __metric_t *mt;
+    size_t base = name->len, hdrlen;
+    unsigned n;
+
+    for (n = 2; uproc_htable_find(&m->names, __name_hash(name->data, name->len),
+                                  (void*)name->data, (void*)name->len, NULL); ++n) {
+        name->len = base;
+        if (uproc_strbuf_printf(name, "_%u", n))
+            return NULL;
+    }
+
+    hdrlen = strlen("# TYPE ") + name->len + 1 + strlen(kind) + 1;
+    mt = malloc(sizeof(*mt) + hdrlen + name->len + 1);
+    if (!mt)
+        return NULL;
+    INIT_HLIST_NODE(&mt->hlink);
+    mt->hdrlen = hdrlen;
+    mt->namelen = name->len;
+    sprintf(mt->text, "# TYPE %.*s %s\n%.*s", (int)name->len, name->data, kind,
+            (int)name->len, name->data);
+    uproc_htable_insert(&m->names, &mt->hlink, __name_hash(name->data, name->len),
+                        (void*)name->data, (void*)name->len, NULL);
+    return mt;
+}
+
+static __metric_t* __metric(__metrics_t *m, uproc_dentry_t *entry, const char *kind) {
+    void *mt = __atomic_load_n(&entry->metric, __ATOMIC_ACQUIRE);
+    uproc_strbuf_t name;
+
+    if (mt)
+        return (__metric_t *)mt;
+
+    memset(&name, 0, sizeof(name));
+    if (__metric_name(m, entry, &name)) {
+        uproc_strbuf_free(&name);
+        return NULL;
+    }
+    // concurrent scrapes may get here for the same entry, the first one names it
+    pthread_mutex_lock(&m->lock);
+    mt = __atomic_load_n(&entry->metric, __ATOMIC_ACQUIRE);
+    if (!mt && (mt = __metric_build(m, &name, kind)))
+        __atomic_store_n(&entry->metric, mt, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&m->lock);
+    uproc_strbuf_free(&name);
+    return (__metric_t *)mt;
+}
+
+static int __append_double(uproc_strbuf_t *out, double v) {
+    if (isnan(v))
+        return uproc_strbuf_append(out, "NaN", 3);
+    if (isinf(v))
+        return v > 0 ? uproc_strbuf_append(out, "+Inf", 4) : uproc_strbuf_append(out, "-Inf", 4);
+    return uproc_strbuf_printf(out, "%.17g", v);
+}
+
+/* formats the binary record at @rec, see uproc_render_entry_binary() */
+static int __append_record(uproc_strbuf_t *out, const unsigned char *rec) {
+    uproc_type_t type = rec[0];
+    size_t size = rec[1], i;
+    unsigned char raw[sizeof(long double)];
+    uint64_t u = 0;
+    float f;
+    double d;
+    long double ld;
+
+    // records are little-endian
+    for (i = 0; i < size; ++i) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        raw[size - 1 - i] = rec[2 + i];
+#else
+        raw[i] = rec[2 + i];
+#endif
+    }
+
+    switch (type) {
+    case UPROC_TYPE_FLOAT:
+        memcpy(&f, raw, sizeof(f));
+        return __append_double(out, f);
+    case UPROC_TYPE_DOUBLE:
+        memcpy(&d, raw, sizeof(d));
+        return __append_double(out, d);
+    case UPROC_TYPE_LDOUBLE:
+        memcpy(&ld, raw, sizeof(ld));
+        return __append_double(out, (double)ld);
+    default:
+        break;
+    }
+
+    for (i = 0; i < size; ++i)
+        u |= (uint64_t)rec[2 + i] << (i * 8);
+    if (__is_signed(type) && size < 8 && (u >> (size * 8 - 1)) & 1)
+        u |= ~(uint64_t)0 << (size * 8);
+    if (__is_signed(type))
+        return uproc_strbuf_printf(out, "%lld", (long long)u);
+    return uproc_strbuf_printf(out, "%llu", (unsigned long long)u);
+}
+
+static int __metrics_hist(__metrics_t *m, uproc_dentry_t *entry, uproc_strbuf_t *out) {
+    uproc_hist_snapshot_t snap;
+    __metric_t *mt = __metric(m, entry, "summary");
+    const char *name;
+    size_t i;
+    int n;
+
+    if (!mt)
+        return -ENOMEM;
+    name = mt->text + mt->hdrlen;
+    n = (int)mt->namelen;
+    uproc_hist_snapshot((uproc_hist_t *)entry->private_data, &snap);
+
+    if (uproc_strbuf_append(out, mt->text, mt->hdrlen))
+        return -ENOMEM;
+    for (i = 0; i < sizeof(__quantiles) / sizeof(__quantiles[0]); ++i) {
+        if (uproc_strbuf_printf(out, "%.*s{quantile=\"%g\"} %llu\n", n, name, __quantiles[i],
+                                (unsigned long long)uproc_hist_percentile(&snap, __quantiles[i])))
+            return -ENOMEM;
+    }
+    return uproc_strbuf_printf(out, "%.*s_sum %llu\n%.*s_count %llu\n",
+                               n, name, (unsigned long long)snap.sum,
+                               n, name, (unsigned long long)snap.count);
+}
+
+static int __metrics_walk(__metrics_t *m, uproc_dentry_t *dir,
+                          uproc_strbuf_t *out, uproc_strbuf_t *rec) {
+    uproc_dentry_t *p;
+    __metric_t *mt;
+    int ret;
+
+    for (p = uproc_dentry_children(dir); p; p = p->next) {
+        if (S_ISDIR(p->mode)) {
+            if ((ret = __metrics_walk(m, p, out, rec)))
+                return ret;
+            continue;
+        }
+        if (p->type == UPROC_TYPE_HIST) {
+            if ((ret = __metrics_hist(m, p, out)))
+                return ret;
+            continue;
+        }
+
+        rec->len = 0;
+        ret = uproc_render_entry_binary(p, rec);
+        if (ret == -ENOTSUP)
+            continue;
+        if (ret)
+            return ret;
+
+        mt = __metric(m, p, p->type == UPROC_TYPE_COUNTER ? "counter" : "gauge");
+        if (!mt ||
+            uproc_strbuf_append(out, mt->text, mt->hdrlen + mt->namelen) ||
+            (p->type == UPROC_TYPE_COUNTER && uproc_strbuf_append(out, "_total", 6)) ||
+            uproc_strbuf_append(out, " ", 1) ||
+            __append_record(out, (const unsigned char *)rec->data) ||
+            uproc_strbuf_append(out, "\n", 1))
+            return -ENOMEM;
+    }
+    return 0;
+}
+
+static int __metrics_render_proc(uproc_strbuf_t *out, void *private_data) {
+    __metrics_t *m = (__metrics_t *)private_data;
+    uproc_strbuf_t rec;
+    int ret;
+
+    memset(&rec, 0, sizeof(rec));
+    ret = __metrics_walk(m, m->root, out, &rec);
+    uproc_strbuf_free(&rec);
+    if (ret)
+        return ret;
+    return uproc_strbuf_append(out, "# EOF\n", 6);
+}
+
+static void __metrics_free(void *private_data) {
+    __metrics_t *m = (__metrics_t *)private_data;
+    // the names themselves go away with their entries
+    uproc_htable_free(&m->names);
+    pthread_mutex_destroy(&m->lock);
+    free(m->prefix);
+    free(m);
+}
+
+int uproc_enable_metrics(uproc_ctx_t *ctx, const char *prefix) {
+    uproc_dentry_t *ent;
+    __metrics_t *m;
+    size_t len = prefix ? strlen(prefix) : 0;
+    int ret;
+
+    if (!ctx)
+        return -EINVAL;
+    m = malloc(sizeof(*m));
+    if (!m)
+        return -ENOMEM;
+    m->root = ctx->root;
+    m->prefix = malloc(len + 2);
+    if (!m->prefix) {
+        free(m);
+        return -ENOMEM;
+    }
+    if (uproc_htable_init(&m->names, 0.75, __metric_hash, __metric_equal)) {
+        free(m->prefix);
+        free(m);
+        return -ENOMEM;
+    }
+    pthread_mutex_init(&m->lock, NULL);
+    if (len) {
+        memcpy(m->prefix, prefix, len);
+        m->prefix[len++] = '_';
+    }
+    m->prefix[len] = '\0';
+
+    ent = uproc_entry_prepare(ctx, UPROC_METRICS_NAME, S_IRUSR | S_IRGRP | S_IROTH, 0,
+                              ctx->root, NULL, NULL, (void*)m);
+    if (ent) {
+        ent->render_proc = __metrics_render_proc;
+        ent->free_proc = __metrics_free;
+        ent->flags |= UPROC_DENTRY_VIRTUAL;
+    }
+    if (!ent) {
+        __metrics_free(m);
+        return -ENOMEM;
+    }
+    // -EEXIST if already enabled
+    if ((ret = uproc_entry_commit(ctx, ent)))
+        __metrics_free(m);
+    return ret;
+}
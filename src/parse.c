@@ -0,0 +1,280 @@
+#include <uproc.h>
+
+#include <stdint.h>
+#include <float.h>
+#include <string.h>
+#include <errno.h>
+
+/*
+* Bounded numeric parsers used by the write handlers.
+* Unlike strto*(), they work directly on (@s, @len), so there is no need
+* to copy the request into a null-terminated buffer, no locale lookup and
+* no errno juggling. Leading and trailing whitespace is accepted, anything
+* else after the number is rejected with -EINVAL.
+*/
+
+#define __PARSE_FALLBACK_SIZE 128
+
+static inline int __isspace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static inline int __isdigit(char c) {
+    return (unsigned char)(c - '0') < 10;
+}
+
+static inline const char *__skip_space(const char *p, const char *end) {
+    while (p < end && __isspace(*p))
+        ++p;
+    return p;
+}
+
+/* 0 if only whitespace remains in [@p, @end) */
+static inline int __check_tail(const char *p, const char *end) {
+    return __skip_space(p, end) == end ? 0 : -EINVAL;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define __PARSE_SWAR 1
+/* SWAR digit-run parsing, 8 ascii digits per step. */
+static inline int __is_8digits(uint64_t v) {
+    return ((v & 0xF0F0F0F0F0F0F0F0ULL) |
+            (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+            0x3333333333333333ULL;
+}
+
+static inline uint32_t __parse_8digits(uint64_t v) {
+    const uint64_t mask = 0x000000FF000000FFULL;
+    const uint64_t mul1 = 0x000F424000000064ULL; /* 100 + (1000000ULL << 32) */
+    const uint64_t mul2 = 0x0000271000000001ULL; /* 1 + (10000ULL << 32) */
+    v -= 0x3030303030303030ULL;
+    v = (v * 10) + (v >> 8);
+    v = (((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32;
+    return (uint32_t)v;
+}
+#endif
+
+/*
+* Parse a run of decimal digits starting at *@pp into @x.
+* *@pp is advanced past the digits. *@ndigits receives the number of digits consumed.
+* returns -ERANGE if the run does not fit in 64 bits, the run is consumed anyway.
+*/
+static int __parse_digits(const char **pp, const char *end, uint64_t *x, size_t *ndigits) {
+    const char *p = *pp, *start = p;
+    uint64_t r = 0;
+    int overflow = 0;
+
+#ifdef __PARSE_SWAR
+    while (end - p >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, p, sizeof(chunk));
+        if (!__is_8digits(chunk))
+            break;
+        if (!overflow && (__builtin_mul_overflow(r, 100000000ULL, &r) ||
+                          __builtin_add_overflow(r, __parse_8digits(chunk), &r)))
+            overflow = 1;
+        p += 8;
+    }
+#endif
+    while (p < end && __isdigit(*p)) {
+        unsigned d = *p - '0';
+        if (!overflow && (__builtin_mul_overflow(r, 10, &r) ||
+                          __builtin_add_overflow(r, d, &r)))
+            overflow = 1;
+        ++p;
+    }
+
+    *pp = p;
+    *ndigits = p - start;
+    *x = r;
+    return overflow ? -ERANGE : 0;
+}
+
+/*
+* Parse [+-]digits surrounded by whitespace.
+* *@neg is set if a '-' sign is present.
+*/
+static int __parse_integer(const char *s, size_t len, uint64_t *mag, int *neg) {
+    const char *p = s, *end = s + len;
+    size_t ndigits;
+    int ret;
+
+    p = __skip_space(p, end);
+    *neg = 0;
+    if (p < end && (*p == '+' || *p == '-')) {
+        *neg = (*p == '-');
+        ++p;
+    }
+
+    ret = __parse_digits(&p, end, mag, &ndigits);
+    if (ndigits == 0)
+        return -EINVAL;
+    if (__check_tail(p, end))
+        return -EINVAL;
+    return ret;
+}
+
+int uproc_parse_uint(const char *s, size_t len, uint64_t max, uint64_t *v) {
+    uint64_t x;
+    int neg, ret;
+
+    if ((ret = __parse_integer(s, len, &x, &neg)))
+        return ret;
+    if (neg && x)
+        return -ERANGE;
+    if (x > max)
+        return -ERANGE;
+    *v = x;
+    return 0;
+}
+
+int uproc_parse_int(const char *s, size_t len, int64_t min, int64_t max, int64_t *v) {
+    uint64_t x;
+    int neg, ret;
+
+    if ((ret = __parse_integer(s, len, &x, &neg)))
+        return ret;
+
+    if (neg) {
+        /* -(min + 1) + 1 is the magnitude of @min without overflowing */
+        if (min >= 0 ? x != 0 : x > (uint64_t)-(min + 1) + 1)
+            return -ERANGE;
+        *v = x ? -(int64_t)(x - 1) - 1 : 0;
+    } else {
+        if (max < 0 || x > (uint64_t)max)
+            return -ERANGE;
+        *v = (int64_t)x;
+    }
+    return 0;
+}
+
+/* exactly representable powers of ten for the fast path */
+static const double __pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+* Clinger's fast path: [+-]digits[.digits][(e|E)[+-]digits] whose
+* significand fits in 53 bits and whose decimal exponent is within [-22, 22]
+* is converted exactly with a single multiplication or division.
+* returns 1 if @s was handled, 0 if the caller needs to fall back.
+*/
+static int __parse_double_fast(const char *s, size_t len, double *v) {
+    const char *p = s, *end = s + len;
+    uint64_t m = 0, e = 0;
+    size_t nint, nfrac = 0;
+    long exp10 = 0;
+    int neg = 0, eneg = 0;
+    double x;
+
+    p = __skip_space(p, end);
+    if (p < end && (*p == '+' || *p == '-')) {
+        neg = (*p == '-');
+        ++p;
+    }
+
+    if (__parse_digits(&p, end, &m, &nint))
+        return 0;
+    if (p < end && *p == '.') {
+        const char *q = ++p;
+        while (p < end && __isdigit(*p)) {
+            if (__builtin_mul_overflow(m, 10, &m) ||
+                __builtin_add_overflow(m, (unsigned)(*p - '0'), &m))
+                return 0;
+            ++p;
+        }
+        nfrac = p - q;
+    }
+    if (nint + nfrac == 0)
+        return 0;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        size_t nexp;
+        ++p;
+        if (p < end && (*p == '+' || *p == '-')) {
+            eneg = (*p == '-');
+            ++p;
+        }
+        if (__parse_digits(&p, end, &e, &nexp) || nexp == 0 || e > 1000)
+            return 0;
+        exp10 = eneg ? -(long)e : (long)e;
+    }
+    if (__check_tail(p, end))
+        return 0;
+
+    exp10 -= nfrac;
+    if (m > (1ULL << 53) || exp10 < -22 || exp10 > 22)
+        return 0;
+
+    x = (double)m;
+    x = exp10 < 0 ? x / __pow10[-exp10] : x * __pow10[exp10];
+    *v = neg ? -x : x;
+    return 1;
+}
+
+/*
+* Copy (@s, @len) into a null-terminated buffer for strtod(), strtold().
+* Only used for inputs the fast path can't handle (inf, nan, hex floats, long significands).
+*/
+static int __copy_token(const char *s, size_t len, char *tok, size_t size) {
+    const char *p = s, *end = s + len;
+    p = __skip_space(p, end);
+    while (end > p && __isspace(end[-1]))
+        --end;
+    if (end == p || (size_t)(end - p) >= size)
+        return -EINVAL;
+    memcpy(tok, p, end - p);
+    tok[end - p] = '\0';
+    return 0;
+}
+
+int uproc_parse_double(const char *s, size_t len, double *v) {
+    char tok[__PARSE_FALLBACK_SIZE];
+    char *endptr;
+    double x;
+
+    if (__parse_double_fast(s, len, v))
+        return 0;
+
+    if (__copy_token(s, len, tok, sizeof(tok)))
+        return -EINVAL;
+    errno = 0;
+    x = strtod(tok, &endptr);
+    if (endptr == tok || *endptr)
+        return -EINVAL;
+    if (errno == ERANGE)
+        return -ERANGE;
+    *v = x;
+    return 0;
+}
+
+int uproc_parse_float(const char *s, size_t len, float *v) {
+    double x;
+    int ret;
+
+    if ((ret = uproc_parse_double(s, len, &x)))
+        return ret;
+    /* finite doubles that overflow float, infinities are passed through */
+    if ((x > FLT_MAX && x <= DBL_MAX) || (x < -FLT_MAX && x >= -DBL_MAX))
+        return -ERANGE;
+    *v = (float)x;
+    return 0;
+}
+
+int uproc_parse_ldouble(const char *s, size_t len, long double *v) {
+    char tok[__PARSE_FALLBACK_SIZE];
+    char *endptr;
+    long double x;
+
+    if (__copy_token(s, len, tok, sizeof(tok)))
+        return -EINVAL;
+    errno = 0;
+    x = strtold(tok, &endptr);
+    if (endptr == tok || *endptr)
+        return -EINVAL;
+    if (errno == ERANGE)
+        return -ERANGE;
+    *v = x;
+    return 0;
+}
@@ -0,0 +1,179 @@
+#include <uproc.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+
+/*
+* Rate entries sample their source only when they are read,
+* the application's hot path is not involved at all.
+*/
+
+#define __RATE_NSAMPLES 32
+
+/*
+* Reads closer than this to the newest sample are repeats of the read that took it,
+* e.g. a seqlock retry or a bulk render of the same scrape: they take no sample
+* and measure against the same base, so they can't wipe out the delta.
+*/
+#define __RATE_MIN_INTERVAL_NS 10000000ULL
+
+struct __rate_sample {
+    uint64_t v;
+    uint64_t ts;    // CLOCK_MONOTONIC, in nanoseconds
+};
+
+typedef struct {
+    uint64_t           (*sample)(void *src);
+    void                *src;
+    uint64_t             window;  // in nanoseconds, 0 means since the previous read
+    pthread_mutex_t      lock;
+    unsigned             head;    // index of the newest sample
+    unsigned             n;       // number of valid samples
+    struct __rate_sample samples[__RATE_NSAMPLES];
+} __rate_t;
+
+static uint64_t __sample_u64(void *src) {
+    return __atomic_load_n((const uint64_t *)src, __ATOMIC_RELAXED);
+}
+
+static uint64_t __sample_counter(void *src) {
+    return uproc_counter_read((uproc_counter_t *)src);
+}
+
+/*
+* Pick the sample to compute the rate against.
+* Without a window that is the previous read, otherwise the newest sample
+* that is at least @window old, or the oldest one if none is old enough yet.
+*/
+static struct __rate_sample* __rate_base(__rate_t *r, uint64_t now) {
+    unsigned i, idx;
+
+    if (r->n == 0)
+        return NULL;
+    if (r->window == 0) {
+        if (now - r->samples[r->head].ts >= __RATE_MIN_INTERVAL_NS)
+            return &r->samples[r->head];
+        // a repeat read, measure against the base of the read it repeats
+        if (r->n == 1)
+            return NULL;
+        return &r->samples[(r->head + __RATE_NSAMPLES - 1) % __RATE_NSAMPLES];
+    }
+
+    for (i = 0; i < r->n; ++i) {
+        idx = (r->head + __RATE_NSAMPLES - i) % __RATE_NSAMPLES;
+        if (now - r->samples[idx].ts >= r->window)
+            return &r->samples[idx];
+    }
+    return &r->samples[(r->head + __RATE_NSAMPLES - r->n + 1) % __RATE_NSAMPLES];
+}
+
+static void __rate_push(__rate_t *r, uint64_t v, uint64_t now) {
+    /*
+    * With a window, keep samples at least window / (__RATE_NSAMPLES / 2) apart
+    * so that the ring always covers the window no matter how often it is read.
+    */
+    uint64_t gap = r->window / (__RATE_NSAMPLES / 2);
+
+    if (gap < __RATE_MIN_INTERVAL_NS)
+        gap = __RATE_MIN_INTERVAL_NS;
+    if (r->n && now - r->samples[r->head].ts < gap)
+        return;
+
+    r->head = (r->head + 1) % __RATE_NSAMPLES;
+    r->samples[r->head].v = v;
+    r->samples[r->head].ts = now;
+    if (r->n < __RATE_NSAMPLES)
+        ++r->n;
+}
+
+static int __rate_read_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
+    __rate_t *r = (__rate_t *)private_data;
+    struct __rate_sample *base;
+    uint64_t v, now, delta = 0, interval = 0;
+    double rate = 0;
+    int n;
+
+    pthread_mutex_lock(&r->lock);
+    v = r->sample(r->src);
+    now = __uproc_now_ns();
+    base = __rate_base(r, now);
+    if (base) {
+        // a counter that went backwards has been reset, count from 0
+        delta = v >= base->v ? v - base->v : v;
+        interval = now - base->ts;
+        if (interval)
+            rate = (double)delta * 1e9 / interval;
+    }
+    __rate_push(r, v, now);
+    pthread_mutex_unlock(&r->lock);
+
+    n = snprintf(buf->mem, buf->size, "rate %.3f\ndelta %llu\ninterval_ms %llu\n",
+                 rate, (unsigned long long)delta,
+                 (unsigned long long)(interval / 1000000));
+    if (n >= buf->size)
+        n = buf->size;
+    *done = 1;
+    return n;
+}
+
+static void __rate_free(void *private_data) {
+    __rate_t *r = (__rate_t *)private_data;
+    pthread_mutex_destroy(&r->lock);
+    free(r);
+}
+
+static uproc_dentry_t* __uproc_rate_create_internal(uproc_ctx_t *ctx,
+                                                    const char *name,
+                                                    mode_t mode,
+                                                    uproc_dentry_t* parent,
+                                                    unsigned window_ms,
+                                                    uint64_t (*sample)(void *src),
+                                                    void *src) {
+    uproc_dentry_t *ent;
+    __rate_t *r = malloc(sizeof(*r));
+
+    if (!r) {
+        if (ctx->dbg)
+            fprintf(stderr, "uproc: memory shortage, can't allocate rate state for \"%s\"\n", name);
+        return NULL;
+    }
+    memset(r, 0, sizeof(*r));
+    r->sample = sample;
+    r->src = src;
+    r->window = (uint64_t)window_ms * 1000000;
+    pthread_mutex_init(&r->lock, NULL);
+
+    ent = uproc_entry_prepare(ctx, name, mode, 4096, parent,
+                              __rate_read_proc, /* write_proc */ NULL, (void*)r);
+    if (ent)
+        ent->free_proc = __rate_free;
+    if (!ent || uproc_entry_commit(ctx, ent)) {
+        __rate_free(r);
+        return NULL;
+    }
+    return ent;
+}
+
+uproc_dentry_t* uproc_create_entry_rate(uproc_ctx_t *ctx,
+                                        const char *name, // name of the entry
+                                        mode_t mode,      // permissions
+                                        uproc_dentry_t* parent,
+                                        unsigned window_ms,
+                                        const uint64_t *v
+                                        ) {
+    return __uproc_rate_create_internal(ctx, name, mode, parent, window_ms,
+                                        __sample_u64, (void*)v);
+}
+
+uproc_dentry_t* uproc_create_entry_counter_rate(uproc_ctx_t *ctx,
+                                                const char *name, // name of the entry
+                                                mode_t mode,      // permissions
+                                                uproc_dentry_t* parent,
+                                                unsigned window_ms,
+                                                uproc_counter_t *c
+                                                ) {
+    return __uproc_rate_create_internal(ctx, name, mode, parent, window_ms,
+                                        __sample_counter, (void*)c);
+}
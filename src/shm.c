@@ -0,0 +1,246 @@
+#include <uproc.h>
+#include <shm.h>
+
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+// entries which can't be exported, they are not looked at again
+#define __SHM_SLOT_NONE UINT_MAX
+
+struct uproc_shm {
+    char            *name;
+    char            *base;
+    size_t           size;
+    unsigned         capacity;
+    unsigned         nentries;
+    pthread_mutex_t  lock;      // serializes the exports, guards @scratch and @nentries
+    uproc_strbuf_t   scratch;   // binary record of the entry being copied
+};
+
+static inline uproc_shm_dirent_t* __shm_dirent(struct uproc_shm *shm, unsigned i) {
+    return (uproc_shm_dirent_t *)(shm->base + sizeof(uproc_shm_hdr_t)) + i;
+}
+
+static inline size_t __shm_slot_offset(struct uproc_shm *shm, unsigned i) {
+    return UPROC_SHM_SLOTS((size_t)shm->capacity) + i * sizeof(uproc_shm_slot_t);
+}
+
+int uproc_shm_open(uproc_ctx_t *ctx, const char *name, unsigned capacity) {
+    struct uproc_shm *shm;
+    uproc_shm_hdr_t *hdr;
+    void *p;
+    int fd, ret;
+
+    if (!ctx || !name || !capacity)
+        return -EINVAL;
+    if (ctx->shm)
+        return -EBUSY;
+
+    shm = malloc(sizeof(*shm));
+    if (!shm)
+        return -ENOMEM;
+    memset(shm, 0, sizeof(*shm));
+    pthread_mutex_init(&shm->lock, NULL);
+    shm->capacity = capacity;
+    shm->size = UPROC_SHM_SIZE((size_t)capacity);
+    shm->name = strdup(name);
+    if (!shm->name) {
+        free(shm);
+        return -ENOMEM;
+    }
+
+    // never take over a live object, e.g. the one of another instance, its readers would see it wiped;
+    // values are only readable by the owner, like the mount without allow_other
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        ret = -errno;
+        goto fail;
+    }
+    if (ftruncate(fd, shm->size)) {
+        ret = -errno;
+        close(fd);
+        goto fail_unlink;
+    }
+    p = mmap(NULL, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        ret = -errno;
+        goto fail_unlink;
+    }
+
+    shm->base = (char *)p;
+    hdr = (uproc_shm_hdr_t *)p;
+    hdr->version = UPROC_SHM_VERSION;
+    hdr->capacity = capacity;
+    hdr->nentries = 0;
+    // readers check the magic, set it once the rest of the header is valid
+    __atomic_store_n(&hdr->magic, UPROC_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    ctx->shm = shm;
+    return 0;
+
+fail_unlink:
+    shm_unlink(name);
+fail:
+    if (ctx->dbg)
+        fprintf(stderr, "uproc: can't export to shared memory \"%s\", reason: %s\n", name, strerror(-ret));
+    free(shm->name);
+    pthread_mutex_destroy(&shm->lock);
+    free(shm);
+    return ret;
+}
+
+static inline uproc_shm_slot_t* __shm_slot(struct uproc_shm *shm, uproc_dentry_t *entry) {
+    return (uproc_shm_slot_t *)(shm->base + __shm_slot_offset(shm, entry->shm_slot - 1));
+}
+
+/* copies the binary record in @shm->scratch into the slot of @entry */
+static void __shm_store(struct uproc_shm *shm, uproc_dentry_t *entry) {
+    uproc_shm_slot_t *slot = __shm_slot(shm, entry);
+
+    uproc_write_seqbegin(&slot->seq);
+    memcpy(slot->value, shm->scratch.data + UPROC_BINARY_HDR_SIZE,
+           shm->scratch.len - UPROC_BINARY_HDR_SIZE);
+    uproc_write_seqend(&slot->seq);
+}
+
+/* gives @entry a slot and publishes its directory entry, with the value in @shm->scratch */
+static void __shm_add(uproc_ctx_t *ctx, uproc_dentry_t *entry) {
+    struct uproc_shm *shm = ctx->shm;
+    uproc_shm_hdr_t *hdr = (uproc_shm_hdr_t *)shm->base;
+    uproc_shm_dirent_t *d;
+    size_t size = shm->scratch.len - UPROC_BINARY_HDR_SIZE;
+
+    if (shm->nentries == shm->capacity || size > sizeof(((uproc_shm_slot_t*)0)->value)) {
+        if (ctx->dbg)
+            fprintf(stderr, "uproc: no room in shared memory for \"%s\"\n", entry->name);
+        entry->shm_slot = __SHM_SLOT_NONE;
+        return;
+    }
+
+    d = __shm_dirent(shm, shm->nentries);
+    if (uproc_entry_path(entry, d->path, sizeof(d->path)) < 0) {
+        if (ctx->dbg)
+            fprintf(stderr, "uproc: path of \"%s\" is too long for shared memory\n", entry->name);
+        entry->shm_slot = __SHM_SLOT_NONE;
+        return;
+    }
+    d->type = entry->type;
+    d->size = size;
+    d->offset = __shm_slot_offset(shm, shm->nentries);
+
+    entry->shm_slot = ++shm->nentries;
+    __shm_store(shm, entry);
+    // the directory entry and the value are visible before the entry is counted
+    __atomic_store_n(&hdr->nentries, shm->nentries, __ATOMIC_RELEASE);
+}
+
+static int __shm_export(uproc_ctx_t *ctx, uproc_dentry_t *entry) {
+    struct uproc_shm *shm = ctx->shm;
+    int ret;
+
+    // slots handed out by uproc_shm_slot() have a single writer, the application
+    if (entry->shm_slot == __SHM_SLOT_NONE || (entry->flags & UPROC_DENTRY_SHM_OWNED))
+        return 0;
+
+    shm->scratch.len = 0;
+    ret = uproc_render_entry_binary(entry, &shm->scratch);
+    if (ret == -ENOTSUP) {
+        entry->shm_slot = __SHM_SLOT_NONE;
+        return 0;
+    }
+    if (ret)
+        return ret;
+
+    if (!entry->shm_slot)
+        __shm_add(ctx, entry);
+    else
+        __shm_store(shm, entry);
+    return 0;
+}
+
+static int __shm_sync(uproc_ctx_t *ctx, uproc_dentry_t *dir) {
+    uproc_dentry_t *p;
+    int ret;
+
+    for (p = uproc_dentry_children(dir); p; p = p->next) {
+        if (S_ISDIR(p->mode))
+            ret = __shm_sync(ctx, p);
+        else
+            ret = __shm_export(ctx, p);
+        if (ret)
+            return ret;
+    }
+    return 0;
+}
+
+int uproc_shm_sync(uproc_ctx_t *ctx) {
+    int ret;
+
+    if (!ctx || !ctx->shm)
+        return -EINVAL;
+    pthread_mutex_lock(&ctx->shm->lock);
+    ret = __shm_sync(ctx, ctx->root);
+    if (!ret)
+        ret = ctx->shm->nentries;
+    pthread_mutex_unlock(&ctx->shm->lock);
+    return ret;
+}
+
+void uproc_shm_update(uproc_ctx_t *ctx, uproc_dentry_t *entry) {
+    if (!ctx || !ctx->shm || !entry || !entry->shm_slot || entry->shm_slot == __SHM_SLOT_NONE ||
+        (entry->flags & UPROC_DENTRY_SHM_OWNED))
+        return;
+    pthread_mutex_lock(&ctx->shm->lock);
+    ctx->shm->scratch.len = 0;
+    if (!uproc_render_entry_binary(entry, &ctx->shm->scratch))
+        __shm_store(ctx->shm, entry);
+    pthread_mutex_unlock(&ctx->shm->lock);
+}
+
+uproc_shm_slot_t* uproc_shm_slot(uproc_ctx_t *ctx, uproc_dentry_t *entry) {
+    uproc_shm_slot_t *slot = NULL;
+
+    if (!ctx || !ctx->shm || !entry || S_ISDIR(entry->mode))
+        return NULL;
+    pthread_mutex_lock(&ctx->shm->lock);
+    if (!entry->shm_slot && __shm_export(ctx, entry))
+        goto out;
+    if (entry->shm_slot && entry->shm_slot != __SHM_SLOT_NONE) {
+        entry->flags |= UPROC_DENTRY_SHM_OWNED;
+        slot = __shm_slot(ctx->shm, entry);
+    }
+out:
+    pthread_mutex_unlock(&ctx->shm->lock);
+    return slot;
+}
+
+static void __shm_forget(uproc_dentry_t *dir) {
+    uproc_dentry_t *p;
+
+    for (p = uproc_dentry_children(dir); p; p = p->next) {
+        p->shm_slot = 0;
+        p->flags &= ~UPROC_DENTRY_SHM_OWNED;
+        if (S_ISDIR(p->mode))
+            __shm_forget(p);
+    }
+}
+
+void uproc_shm_close(uproc_ctx_t *ctx) {
+    struct uproc_shm *shm;
+
+    if (!ctx || !ctx->shm)
+        return;
+    shm = ctx->shm;
+    __shm_forget(ctx->root);
+    munmap(shm->base, shm->size);
+    shm_unlink(shm->name);
+    uproc_strbuf_free(&shm->scratch);
+    free(shm->name);
+    pthread_mutex_destroy(&shm->lock);
+    free(shm);
+    ctx->shm = NULL;
+}
@@ -0,0 +1,218 @@
+#include <uproc.h>
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+/*
+* Self-instrumentation: the "/.uproc" directory exports what uproc costs,
+* the operations are timed by the wrappers uproc_run() serves them with.
+*/
+
+#define __STATS_MODE (S_IRUSR | S_IRGRP | S_IROTH)
+
+static const char *__op_names[UPROC_OP_MAX] = {
+    [UPROC_OP_GETATTR] = "getattr",
+    [UPROC_OP_OPEN]    = "open",
+    [UPROC_OP_READ]    = "read",
+    [UPROC_OP_READDIR] = "readdir",
+    [UPROC_OP_WRITE]   = "write",
+};
+
+static void __stats_free(void *private_data) {
+    uproc_stats_t *st = (uproc_stats_t *)private_data;
+    int i;
+
+    for (i = 0; i < UPROC_OP_MAX; ++i)
+        uproc_hist_free(st->ops[i]);
+    free(st->busy_ns);
+    free(st);
+}
+
+static int __htable_render_proc(uproc_strbuf_t *out, void *private_data) {
+    uproc_ctx_t *ctx = (uproc_ctx_t *)private_data;
+    uproc_htable_stats_t hs;
+
+    // the buckets go away when a registration grows the table
+    pthread_rwlock_rdlock(&ctx->lock);
+    uproc_htable_stats(&ctx->htable, &hs);
+    pthread_rwlock_unlock(&ctx->lock);
+    return uproc_strbuf_printf(out, "buckets %d\nentries %d\nused %d\nload_factor %.3f\nmax_chain %d\n",
+                               hs.len, hs.n_entries, hs.used, hs.load, hs.max_chain);
+}
+
+static void __dentries_count(uproc_dentry_t *dir, uint64_t *n, uint64_t *bytes) {
+    uproc_dentry_t *p;
+
+    for (p = uproc_dentry_children(dir); p; p = p->next) {
+        ++*n;
+        *bytes += sizeof(*p) + p->namelen + 1;
+        if (S_ISDIR(p->mode))
+            __dentries_count(p, n, bytes);
+    }
+}
+
+static int __dentries_render_proc(uproc_strbuf_t *out, void *private_data) {
+    uproc_ctx_t *ctx = (uproc_ctx_t *)private_data;
+    uint64_t n = 1, bytes = sizeof(*ctx->root);
+
+    pthread_rwlock_rdlock(&ctx->lock);
+    bytes += ctx->htable.len * sizeof(struct hlist_head);
+    pthread_rwlock_unlock(&ctx->lock);
+    __dentries_count(ctx->root, &n, &bytes);
+    return uproc_strbuf_printf(out, "count %llu\nbytes %llu\n",
+                               (unsigned long long)n, (unsigned long long)bytes);
+}
+
+/* an entry of the top file, sorted on a copy of its CPU time since the counters keep moving */
+typedef struct {
+    uproc_dentry_t *entry;
+    uint64_t        cpu_ns;
+} __top_entry_t;
+
+/* state of one rendering of the top file */
+typedef struct {
+    __top_entry_t *entries;
+    size_t         n, cap;
+} __top_t;
+
+static int __top_collect(__top_t *t, uproc_dentry_t *dir) {
+    __top_entry_t *entries;
+    uproc_dentry_t *p;
+    uint64_t cpu_ns;
+
+    for (p = uproc_dentry_children(dir); p; p = p->next) {
+        if (S_ISDIR(p->mode)) {
+            if (__top_collect(t, p))
+                return -ENOMEM;
+            continue;
+        }
+        if (!p->cost || !(cpu_ns = __atomic_load_n(&p->cost->cpu_ns, __ATOMIC_RELAXED)))
+            continue;
+        if (t->n == t->cap) {
+            t->cap = t->cap ? t->cap * 2 : 64;
+            entries = realloc(t->entries, t->cap * sizeof(*entries));
+            if (!entries)
+                return -ENOMEM;
+            t->entries = entries;
+        }
+        t->entries[t->n].entry = p;
+        t->entries[t->n++].cpu_ns = cpu_ns;
+    }
+    return 0;
+}
+
+static int __top_cmp(const void *a, const void *b) {
+    uint64_t x = ((const __top_entry_t *)a)->cpu_ns, y = ((const __top_entry_t *)b)->cpu_ns;
+
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static int __top_render_proc(uproc_strbuf_t *out, void *private_data) {
+    uproc_ctx_t *ctx = (uproc_ctx_t *)private_data;
+    uproc_dentry_t *ent;
+    char path[1024];
+    uproc_cost_t c;
+    __top_t t;
+    size_t i;
+    int ret;
+
+    memset(&t, 0, sizeof(t));
+    if ((ret = __top_collect(&t, ctx->root)))
+        goto out;
+    qsort(t.entries, t.n, sizeof(*t.entries), __top_cmp);
+
+    for (i = 0; i < t.n && i < UPROC_STATS_TOP && !ret; ++i) {
+        ent = t.entries[i].entry;
+        c = *ent->cost;
+        if (uproc_entry_path(ent, path, sizeof(path)) < 0)
+            snprintf(path, sizeof(path), ".../%s", ent->name);
+        ret = uproc_strbuf_printf(out, "/%s cpu_ns %llu max_ns %llu reads %llu writes %llu bytes %llu\n",
+                                  path, (unsigned long long)c.cpu_ns, (unsigned long long)c.max_ns,
+                                  (unsigned long long)c.reads, (unsigned long long)c.writes,
+                                  (unsigned long long)c.bytes);
+    }
+out:
+    free(t.entries);
+    return ret;
+}
+
+static void __cost_alloc(uproc_dentry_t *dir) {
+    uproc_dentry_t *p;
+
+    for (p = uproc_dentry_children(dir); p; p = p->next) {
+        if (S_ISDIR(p->mode))
+            __cost_alloc(p);
+        else if (!p->cost)
+            p->cost = calloc(1, sizeof(uproc_cost_t));
+    }
+}
+
+int uproc_enable_stats(uproc_ctx_t *ctx) {
+    uproc_dentry_t *dir, *ops;
+    uproc_stats_t *st;
+    int i;
+
+    if (!ctx)
+        return -EINVAL;
+    if (ctx->stats || uproc_lookup(ctx, "/" UPROC_STATS_NAME))
+        return -EEXIST;
+
+    st = calloc(1, sizeof(*st));
+    if (!st)
+        return -ENOMEM;
+    for (i = 0; i < UPROC_OP_MAX; ++i) {
+        if (!(st->ops[i] = uproc_hist_alloc()))
+            goto nomem;
+    }
+    if (!(st->busy_ns = uproc_counter_alloc()))
+        goto nomem;
+
+    dir = uproc_mkdir(ctx, UPROC_STATS_NAME, NULL);
+    if (!dir) {
+        __stats_free(st);
+        // made by another thread in the meantime
+        if (uproc_lookup(ctx, "/" UPROC_STATS_NAME))
+            return -EEXIST;
+        goto nomem_msg;
+    }
+    // the tree below refers to @st, it goes away with the directory
+    dir->private_data = st;
+    dir->free_proc = __stats_free;
+    dir->flags |= UPROC_DENTRY_VIRTUAL;
+
+    /*
+    * Entries can't be taken out of the tree, so past this point
+    * a failure leaves the directory partly filled in, see uproc.h.
+    */
+    if (!(ops = uproc_mkdir(ctx, "ops", dir)))
+        goto partial;
+    for (i = 0; i < UPROC_OP_MAX; ++i) {
+        if (!uproc_create_entry_hist(ctx, __op_names[i], __STATS_MODE, ops, st->ops[i]))
+            goto partial;
+    }
+    if (!uproc_create_entry_counter(ctx, "busy_ns", __STATS_MODE, dir, st->busy_ns) ||
+        !uproc_create_entry_uint64(ctx, "handles", __STATS_MODE, dir, 1, &st->handles) ||
+        !uproc_create_entry_uint64(ctx, "buffer_bytes", __STATS_MODE, dir, 1, &st->buffer_bytes) ||
+        !uproc_create_entry_render(ctx, "htable", __STATS_MODE, dir, __htable_render_proc, (void*)ctx) ||
+        !uproc_create_entry_render(ctx, "dentries", __STATS_MODE, dir, __dentries_render_proc, (void*)ctx) ||
+        !uproc_create_entry_render(ctx, "top", __STATS_MODE, dir, __top_render_proc, (void*)ctx))
+        goto partial;
+
+    // entries made from now on get their cost accounted as they are created
+    ctx->stats = st;
+    __cost_alloc(ctx->root);
+    return 0;
+
+partial:
+    if (ctx->dbg)
+        fprintf(stderr, "uproc: memory shortage, \"/%s\" is left incomplete\n", UPROC_STATS_NAME);
+    return -ENOTRECOVERABLE;
+
+nomem:
+    __stats_free(st);
+nomem_msg:
+    if (ctx->dbg)
+        fprintf(stderr, "uproc: memory shortage, can't enable the stats\n");
+    return -ENOMEM;
+}
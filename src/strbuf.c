@@ -0,0 +1,63 @@
+#include <uproc.h>
+
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+
+int uproc_strbuf_reserve(uproc_strbuf_t *sb, size_t n) {
+    size_t cap;
+    char *data;
+
+    if (sb->len + n <= sb->cap)
+        return 0;
+
+    cap = sb->cap ? sb->cap : 256;
+    while (cap < sb->len + n)
+        cap *= 2;
+    data = realloc(sb->data, cap);
+    if (!data)
+        return -ENOMEM;
+    sb->data = data;
+    sb->cap = cap;
+    return 0;
+}
+
+int uproc_strbuf_append(uproc_strbuf_t *sb, const char *data, size_t len) {
+    if (!len)
+        return 0;
+    if (uproc_strbuf_reserve(sb, len))
+        return -ENOMEM;
+    memcpy(sb->data + sb->len, data, len);
+    sb->len += len;
+    return 0;
+}
+
+int uproc_strbuf_printf(uproc_strbuf_t *sb, const char *fmt, ...) {
+    va_list ap;
+    int n;
+
+    // try the room left first, most lines are short
+    if (uproc_strbuf_reserve(sb, 64))
+        return -ENOMEM;
+    va_start(ap, fmt);
+    n = vsnprintf(sb->data + sb->len, sb->cap - sb->len, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return -EINVAL;
+
+    if ((size_t)n >= sb->cap - sb->len) {
+        if (uproc_strbuf_reserve(sb, n + 1))
+            return -ENOMEM;
+        va_start(ap, fmt);
+        vsnprintf(sb->data + sb->len, sb->cap - sb->len, fmt, ap);
+        va_end(ap);
+    }
+    sb->len += n;
+    return 0;
+}
+
+void uproc_strbuf_free(uproc_strbuf_t *sb) {
+    free(sb->data);
+    memset(sb, 0, sizeof(*sb));
+}
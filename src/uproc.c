@@ -1,6 +1,8 @@
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
+#include <pthread.h>
 
 #include <uproc.h>
 
@@ -9,6 +11,8 @@
 #include <fuse.h>
 
 #define _UPROC_LOAD_FACTOR 0.75
+// limit of the bytes buffered by a handle of the query file, or of an assembled entry without a size
+#define UPROC_QUERY_MAX (1 << 20)
 
 #define S_IRWXUGO   (S_IRWXU|S_IRWXG|S_IRWXO)
 #define S_IALLUGO   (S_ISUID|S_ISGID|S_ISVTX|S_IRWXUGO)
@@ -18,7 +22,7 @@
 
 
 #ifdef _UPROC_TEST
-static int _uproc_errno;
+static __thread int _uproc_errno; // per thread, lookups may run concurrently
 int uproc_errno() {
     return _uproc_errno;
 }
@@ -69,86 +73,57 @@ unsigned uproc_dentry_equal(struct hlist_node* p, void *d1, void*d2, void*d3) {
            !strncmp(name, entry->name, namelen);
 }
 
-/* 
-* find the range in @str delimited by @c
-* After returned, @p points to the first occurrence of @c, 
-* @next points to the second occurrence of @c.
-* if @c is not found in @str, 0 is stored in @p and next points
-* to a null byte at the end of @str.
-*/
-static inline void __range_strchr(const char *str, const char **p, const char **next, char c) {
-    *p = strchr(str, c);
-    if (!*p) {
-        *next = str + strlen(str); /* point to the null byte */
-        return;
-    }
-    *next = strchr(*p + 1, c);
-    if (!*next)
-        *next = *p + strlen(*p); /* point to the null byte */
-}
-
 /*
 * search for the last part of the path which does not contain '/'.
 * @ret should store the parent of the path @name, otherwise
 * the search will start at the root.
 * After returned, *lp stores the start of the last part,
 * *ret stores the parent dir. 
-* return -ENOENT if the path does not exist.
+* return -ENOENT if the path does not exist,
+* -ENOTDIR if a part other than the last one is not a directory.
 */
 static int __find_last_part(uproc_ctx_t *ctx, const char *name,
                             uproc_dentry_t **ret, const char **lp) {
-    const char *p, *pnext;
-    const char *prev = name;
-    uproc_dentry_t *parent = NULL, *entry = NULL;
+    const char *p = name, *slash;
+    uproc_dentry_t *parent;
     struct hlist_node *n;
     size_t namelen;
     parent = *ret;
-    if (!parent || *prev == '/')
+    if (!parent || *p == '/')
         parent = ctx->root;
-    
-    entry = parent;
-    // skip over front '/'s
-    while (*prev && *prev == '/')
-        ++prev;
-
-    if (prev > name) {// point @prev to the last '/'
-        *lp = prev--;
-    } else {
-        *lp = prev;    
-    }
 
-    for (;*prev;) {
-        __range_strchr(prev, &p, &pnext, '/');
-        if (!p) {
-            *lp = prev;
-            break;
-        } else if (!*pnext) {
-            *lp = p + 1;
+    for (;;) {
+        // skip over '/'s
+        while (*p == '/')
+            ++p;
+        slash = strchr(p, '/');
+        if (!slash)
             break;
-        }
-
-        ++p;
-        namelen = pnext - p;
 
+        namelen = slash - p;
         n = uproc_htable_find(&ctx->htable, __uproc_dentry_hash(parent, p, namelen),
                           (void*)parent, (void*)p, (void*)namelen);
         if (!n) {
             _SET_UPROC_ERRNO(-ENOENT);
             return -ENOENT;
         }
-        entry = hlist_entry(n, uproc_dentry_t, hlink);
-        prev = p;
-        parent = entry;
+        parent = hlist_entry(n, uproc_dentry_t, hlink);
+        if (!S_ISDIR(parent->mode)) {
+            _SET_UPROC_ERRNO(-ENOTDIR);
+            return -ENOTDIR;
+        }
+        p = slash;
     }
 
+    *lp = p;
     *ret = parent;
     _SET_UPROC_ERRNO(-0);
     return 0;
 }
 
-static int __uproc_lookup(uproc_ctx_t *ctx, const char *name,
-                          uproc_dentry_t **pentry) {
-    uproc_dentry_t *parent;
+static int __uproc_lookup_locked(uproc_ctx_t *ctx, const char *name,
+                                 uproc_dentry_t **pentry) {
+    uproc_dentry_t *parent = NULL;
     struct hlist_node *n;
     size_t namelen;
     int ret = 0;
@@ -189,6 +164,48 @@ static int __uproc_lookup(uproc_ctx_t *ctx, const char *name,
     return ret;
 }
 
+static int __uproc_lookup(uproc_ctx_t *ctx, const char *name,
+                          uproc_dentry_t **pentry) {
+    int ret;
+
+    pthread_rwlock_rdlock(&ctx->lock);
+    ret = __uproc_lookup_locked(ctx, name, pentry);
+    pthread_rwlock_unlock(&ctx->lock);
+    return ret;
+}
+
+uproc_dentry_t* uproc_lookup(uproc_ctx_t *ctx, const char *path) {
+    uproc_dentry_t *ent;
+
+    if (!ctx || __uproc_lookup(ctx, path, &ent))
+        return NULL;
+    return ent;
+}
+
+int uproc_entry_path(uproc_dentry_t *entry, char *buf, size_t size) {
+    size_t len = 0, n;
+    int ret;
+
+    if (!entry->parent) {
+        if (!size)
+            return -ENAMETOOLONG;
+        buf[0] = '\0';
+        return 0;
+    }
+    if ((ret = uproc_entry_path(entry->parent, buf, size)) < 0)
+        return ret;
+    len = ret;
+    n = entry->namelen + (len ? 1 : 0);
+    if (len + n >= size)
+        return -ENAMETOOLONG;
+    if (len)
+        buf[len++] = '/';
+    memcpy(buf + len, entry->name, entry->namelen);
+    len += entry->namelen;
+    buf[len] = '\0';
+    return len;
+}
+
 static uproc_dentry_t* __uproc_create(uproc_ctx_t *ctx,
                                       const char *name,
                                       mode_t mode,
@@ -196,13 +213,17 @@ static uproc_dentry_t* __uproc_create(uproc_ctx_t *ctx,
     const char *lp;
     uproc_dentry_t *new_entry = NULL;
     size_t namelen;
+    int ret;
     if (!name || !strlen(name)) {
         if (ctx->dbg)
             fprintf(stderr, "uproc: empty pathname!\n");
         goto out;
     }
 
-    if (__find_last_part(ctx, name, parent, &lp)) {
+    pthread_rwlock_rdlock(&ctx->lock);
+    ret = __find_last_part(ctx, name, parent, &lp);
+    pthread_rwlock_unlock(&ctx->lock);
+    if (ret) {
         if (ctx->dbg)
             fprintf(stderr, "uproc: some parts of \"%s\" does not exist!\n", name);
         goto out;
@@ -230,6 +251,9 @@ static uproc_dentry_t* __uproc_create(uproc_ctx_t *ctx,
     new_entry->gid = getgid();
     new_entry->mode = mode;
     INIT_HLIST_NODE(&new_entry->hlink);
+    // without it the entry is only left out of the accounting
+    if (ctx->stats && !S_ISDIR(mode))
+        new_entry->cost = calloc(1, sizeof(uproc_cost_t));
 out:
     return new_entry;
 }
@@ -241,16 +265,21 @@ static int __uproc_register(uproc_ctx_t *ctx,
     if (!parent)
         parent = ctx->root;
 
+    pthread_rwlock_wrlock(&ctx->lock);
     if ((ret = uproc_htable_insert(&ctx->htable, &entry->hlink,
                 __uproc_dentry_hash(parent, entry->name, entry->namelen), 
                 (void*)parent, (void*)entry->name, (void*)entry->namelen))) {
+        pthread_rwlock_unlock(&ctx->lock);
         _SET_UPROC_ERRNO(ret);
         return ret;
     }
 
     entry->parent = parent;
     entry->next = parent->children;
-    parent->children = entry;
+    // walks of the tree outside of the lock see the entry fully initialized,
+    // see uproc_dentry_children()
+    __atomic_store_n(&parent->children, entry, __ATOMIC_RELEASE);
+    pthread_rwlock_unlock(&ctx->lock);
 
     _SET_UPROC_ERRNO(-0);
     return ret;
@@ -271,8 +300,12 @@ int uproc_ctx_init(uproc_ctx_t *ctx, const char *mount_point, int dbg) {
         _SET_UPROC_ERRNO(ret);
         return ret;
     }
+    pthread_rwlock_init(&ctx->lock, NULL);
 
     ctx->dbg = dbg;
+    ctx->bulk = 0;
+    ctx->shm = NULL;
+    ctx->stats = NULL;
     ctx->mount_point = mount_point;
     memset(ctx->root, 0, sizeof(*ctx->root));
     ctx->root->namelen = 1;
@@ -291,30 +324,193 @@ int uproc_ctx_init(uproc_ctx_t *ctx, const char *mount_point, int dbg) {
 }
 
 
+/*
+* Last rendered content of an entry, see uproc_entry_set_cache_ttl().
+* Once made it stays with the entry until __uproc_destroy_dentry(),
+* readers may still be using it when the program turns caching off.
+*/
+struct uproc_cache {
+    pthread_mutex_t lock;
+    pthread_cond_t  rendered;   // broadcast when a render completes
+    uint64_t        ttl;        // in nanoseconds, 0 only shares renders in flight, atomic
+    uint64_t        ts;         // when @data was rendered, CLOCK_MONOTONIC
+    int             valid;
+    unsigned        gen;        // bumped by every invalidation
+    int             rendering;  // a render is in flight
+    unsigned        nrenders;   // completed renders
+    int             ret;        // result of the last render
+    uproc_strbuf_t  data;
+};
+
+static void __uproc_cache_free(struct uproc_cache *c) {
+    if (!c)
+        return;
+    pthread_mutex_destroy(&c->lock);
+    pthread_cond_destroy(&c->rendered);
+    uproc_strbuf_free(&c->data);
+    free(c);
+}
+
+/*
+* Latency budget of the handlers of an entry.
+* The counters and timestamps are updated with atomics, readers never wait for each other.
+* Once made it stays with the entry until __uproc_destroy_dentry(), a budget of 0 turns it off.
+*/
+struct uproc_budget {
+    uint64_t        budget;     // in nanoseconds, 0 if none, atomic
+    int             policy;     // UPROC_BUDGET_*, atomic
+    unsigned        strikes;    // slow calls in a row
+    uint64_t        tripped;    // when the handler was short-circuited, 0 if it is not
+    uint64_t        busy_since; // start of a call in flight, 0 if none
+    unsigned long   nslow;
+    pthread_mutex_t lock;       // guards @last
+    int             has_last;
+    uproc_strbuf_t  last;       // last content, kept for UPROC_BUDGET_STALE
+};
+
+#define __BUDGET_STRIKES  3
+#define __BUDGET_COOLDOWN 1000000000ULL // short-circuited for a second, then tried again
+
+static void __uproc_budget_free(struct uproc_budget *b) {
+    if (!b)
+        return;
+    pthread_mutex_destroy(&b->lock);
+    uproc_strbuf_free(&b->last);
+    free(b);
+}
+
+/* immutable content published by the program, freed with the last reference */
+struct uproc_published {
+    unsigned refs;
+    size_t   len;
+    char     data[];
+};
+
+static void __uproc_published_put(struct uproc_published *p) {
+    if (p && __atomic_sub_fetch(&p->refs, 1, __ATOMIC_ACQ_REL) == 0)
+        free(p);
+}
+
+/*
+* @entry->publock is only held to swap the pointer or take a reference,
+* so neither the program nor the readers ever wait for long.
+*/
+static inline void __uproc_publock(uproc_dentry_t *entry) {
+    while (__atomic_test_and_set(&entry->publock, __ATOMIC_ACQUIRE))
+        uproc_cpu_relax();
+}
+
+static inline void __uproc_pubunlock(uproc_dentry_t *entry) {
+    __atomic_clear(&entry->publock, __ATOMIC_RELEASE);
+}
+
+static struct uproc_published* __uproc_published_get(uproc_dentry_t *entry) {
+    struct uproc_published *p;
+
+    __uproc_publock(entry);
+    p = entry->published;
+    if (p)
+        __atomic_add_fetch(&p->refs, 1, __ATOMIC_RELAXED);
+    __uproc_pubunlock(entry);
+    return p;
+}
+
+static inline int __uproc_is_published(uproc_dentry_t *entry) {
+    return __atomic_load_n(&entry->published, __ATOMIC_RELAXED) != NULL;
+}
+
+/* the cache of @entry if reads are served from it, NULL otherwise */
+static inline struct uproc_cache* __uproc_cache_active(uproc_dentry_t *entry) {
+    struct uproc_cache *c = __atomic_load_n(&entry->cache, __ATOMIC_ACQUIRE);
+
+    if (c && (__atomic_load_n(&c->ttl, __ATOMIC_RELAXED) ||
+              (entry->flags & UPROC_DENTRY_SINGLE_FLIGHT)))
+        return c;
+    return NULL;
+}
+
+/* the budget of @entry if it has one, NULL otherwise */
+static inline struct uproc_budget* __uproc_budget_active(uproc_dentry_t *entry) {
+    struct uproc_budget *b = __atomic_load_n(&entry->budget, __ATOMIC_ACQUIRE);
+
+    if (b && __atomic_load_n(&b->budget, __ATOMIC_ACQUIRE))
+        return b;
+    return NULL;
+}
+
+static inline int __uproc_budget_policy(struct uproc_budget *b) {
+    return __atomic_load_n(&b->policy, __ATOMIC_RELAXED);
+}
+
+/* entries whose content is rendered as a whole instead of read in place */
+static inline int __uproc_is_rendered(uproc_dentry_t *entry) {
+    struct uproc_budget *b;
+
+    return entry->render_proc || entry->async_proc || __uproc_cache_active(entry) ||
+           __uproc_is_published(entry) ||
+           ((b = __uproc_budget_active(entry)) && __uproc_budget_policy(b) == UPROC_BUDGET_STALE);
+}
+
+/* a request to an asynchronous entry, shared by its uproc thread and the completing thread */
+struct uproc_token {
+    pthread_mutex_t lock;
+    pthread_cond_t  completed;
+    unsigned        refs;
+    int             done;
+    int             ret;
+    int             write;     // answers a write, no content
+    uproc_strbuf_t  out;
+    size_t          len;       // of @in
+    char            in[];
+};
+
+static void __uproc_token_put(uproc_token_t *t) {
+    if (__atomic_sub_fetch(&t->refs, 1, __ATOMIC_ACQ_REL))
+        return;
+    pthread_mutex_destroy(&t->lock);
+    pthread_cond_destroy(&t->completed);
+    uproc_strbuf_free(&t->out);
+    free(t);
+}
+
 // recursively release resources of the tree rooted at @r
 void __uproc_destroy_dentry(uproc_dentry_t *r) {
-    uproc_dentry_t *p;
-    for (p = r->children; p; p = p->next) {
+    uproc_dentry_t *p, *next;
+    for (p = r->children; p; p = next) {
+        next = p->next;
         __uproc_destroy_dentry(p);
     }
+    if (r->free_proc)
+        r->free_proc(r->private_data);
+    __uproc_cache_free(r->cache);
+    __uproc_budget_free(r->budget);
+    free(r->cost);
+    __uproc_published_put(r->published);
+    free(r->fmt);
+    free(r->metric);
     free(r);
 }
 
 void uproc_destroy(uproc_ctx_t *ctx) {
-    uproc_dentry_t *p;
+    uproc_dentry_t *p, *next;
     if (!ctx)
         return;
-    for (p = ctx->root->children; p; p = p->next) {
+    uproc_shm_close(ctx);
+    for (p = ctx->root->children; p; p = next) {
+        next = p->next;
         __uproc_destroy_dentry(p);
     }
+    // freed along with its directory
+    ctx->stats = NULL;
     uproc_htable_free(&ctx->htable);
+    pthread_rwlock_destroy(&ctx->lock);
 }
 
 uproc_dentry_t* uproc_mkdir_mode(uproc_ctx_t *ctx,
                                  const char *name,
                                  mode_t mode,
                                  uproc_dentry_t *parent) {
-    int ret;
+    int ret, f;
     uproc_dentry_t *ent;
 
     if (!ctx)
@@ -335,6 +531,11 @@ uproc_dentry_t* uproc_mkdir_mode(uproc_ctx_t *ctx,
         ent = NULL;
     }
 
+    for (f = UPROC_BULK_TEXT; ent && f <= UPROC_BULK_BINARY; f <<= 1) {
+        if (ctx->bulk & f)
+            uproc_create_entry_bulk(ctx, NULL, ent, f);
+    }
+
     return ent;
 }
 
@@ -344,15 +545,14 @@ uproc_dentry_t* uproc_mkdir(uproc_ctx_t *ctx,
     return uproc_mkdir_mode(ctx, name, S_IRUGO | S_IXUGO, parent);
 }
 
-uproc_dentry_t* uproc_create_entry(uproc_ctx_t *ctx,
-                                   const char *name,
-                                   mode_t mode,
-                                   size_t size,
-                                   uproc_dentry_t* parent,
-                                   uproc_read_proc_t read_proc,
-                                   uproc_write_proc_t write_proc,
-                                   void *private_data) {
-    int ret;
+uproc_dentry_t* uproc_entry_prepare(uproc_ctx_t *ctx,
+                                    const char *name,
+                                    mode_t mode,
+                                    size_t size,
+                                    uproc_dentry_t* parent,
+                                    uproc_read_proc_t read_proc,
+                                    uproc_write_proc_t write_proc,
+                                    void *private_data) {
     uproc_dentry_t *ent;
 
     if (!ctx)
@@ -370,18 +570,62 @@ uproc_dentry_t* uproc_create_entry(uproc_ctx_t *ctx,
         ent->write_proc = write_proc;
         ent->private_data = private_data;
         ent->size = size;
-        if ((ret = __uproc_register(ctx, ent, parent))) {
-            if (ctx->dbg)
-                fprintf(stderr, "uproc: failed to register \"%s\" to uproc, reason: %s\n", name, strerror(-ret));
+        // where uproc_entry_commit() links it
+        ent->parent = parent;
+    }
+    return ent;
+}
 
-            free(ent);
-            ent = NULL;
-        }
+int uproc_entry_commit(uproc_ctx_t *ctx, uproc_dentry_t *entry) {
+    int ret;
+
+    if (!ctx || !entry)
+        return -EINVAL;
+    if ((ret = __uproc_register(ctx, entry, entry->parent))) {
+        if (ctx->dbg)
+            fprintf(stderr, "uproc: failed to register \"%s\" to uproc, reason: %s\n", entry->name, strerror(-ret));
+        free(entry->fmt);
+        free(entry->cost);
+        free(entry);
     }
+    return ret;
+}
 
+uproc_dentry_t* uproc_create_entry(uproc_ctx_t *ctx,
+                                   const char *name,
+                                   mode_t mode,
+                                   size_t size,
+                                   uproc_dentry_t* parent,
+                                   uproc_read_proc_t read_proc,
+                                   uproc_write_proc_t write_proc,
+                                   void *private_data) {
+    uproc_dentry_t *ent = uproc_entry_prepare(ctx, name, mode, size, parent,
+                                              read_proc, write_proc, private_data);
+
+    if (ent && uproc_entry_commit(ctx, ent))
+        ent = NULL;
     return ent;
 }
 
+uproc_dentry_t* uproc_create_entry_render(uproc_ctx_t *ctx,
+                                          const char *name,
+                                          mode_t mode,
+                                          uproc_dentry_t* parent,
+                                          uproc_render_proc_t render_proc,
+                                          void *private_data) {
+    uproc_dentry_t *ent = uproc_entry_prepare(ctx, name, mode, 0, parent,
+                                              NULL, NULL, private_data);
+    if (!ent)
+        return NULL;
+    ent->render_proc = render_proc;
+    return uproc_entry_commit(ctx, ent) ? NULL : ent;
+}
+
+void uproc_entry_set_seqlock(uproc_dentry_t *entry, uproc_seqlock_t *sl) {
+    if (entry)
+        entry->seqlock = sl;
+}
+
 static int uproc_opendir(const char *path, struct fuse_file_info *fi) {
     struct fuse_context* fctx = fuse_get_context();
     uproc_ctx_t * ctx = (uproc_ctx_t *)fctx->private_data;
@@ -418,6 +662,7 @@ static int uproc_opendir(const char *path, struct fuse_file_info *fi) {
 static int uproc_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
              off_t offset, struct fuse_file_info *fi)
 {
+    uproc_ctx_t    *ctx = (uproc_ctx_t *)fuse_get_context()->private_data;
     uproc_buf_t    *b = (uproc_buf_t*)fi->fh;;
     uproc_dentry_t *entry, *p;
 
@@ -438,9 +683,11 @@ static int uproc_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
 
     filler(buf, ".", NULL, 0);
     filler(buf, "..", NULL, 0);
+    pthread_rwlock_rdlock(&ctx->lock);
     for (p = entry->children; p; p = p->next) {
         filler(buf, p->name, NULL, 0);
     }
+    pthread_rwlock_unlock(&ctx->lock);
 
     _SET_UPROC_ERRNO(-0);
     return 0;
@@ -503,6 +750,9 @@ static int uproc_open(const char *path, struct fuse_file_info *fi)
     /* TODO: permission checks */
     fi->fh = (uint64_t)b;
     fi->nonseekable = 1;
+    // rendered entries have no fixed size, don't let the kernel cut reads at st_size
+    if (__uproc_is_rendered(ent) || (ent->flags & UPROC_DENTRY_QUERY))
+        fi->direct_io = 1;
 
     _SET_UPROC_ERRNO(-0);
     return 0;
@@ -511,8 +761,10 @@ static int uproc_open(const char *path, struct fuse_file_info *fi)
 int uproc_release(const char *path, struct fuse_file_info *fi) {
     uproc_buf_t *b = (uproc_buf_t*)fi->fh;
     if (b) {
+        fprintf(stderr, "uproc_release: releasing buffer %p\n", b);
+        uproc_strbuf_free(&b->out);
+        uproc_strbuf_free(&b->in);
         free(b);
-        fprintf(stderr, "uproc_release: released buffer %p\n", b);
     }
 
     return 0;
@@ -522,12 +774,637 @@ int uproc_release(const char *path, struct fuse_file_info *fi) {
 int uproc_releasedir(const char *path, struct fuse_file_info *fi) {
     uproc_buf_t *b = (uproc_buf_t*)fi->fh;
     if (b) {
+        fprintf(stderr, "uproc_releasedir: releasing buffer %p\n", b);
         free(b);
-        fprintf(stderr, "uproc_releasedir: released buffer %p\n", b);
     }
     return 0;
 }
 
+/* the seqlock of @entry or of its nearest ancestor which has one */
+static uproc_seqlock_t* __uproc_seqlock(uproc_dentry_t *entry) {
+    for (; entry; entry = entry->parent) {
+        if (entry->seqlock)
+            return entry->seqlock;
+    }
+    return NULL;
+}
+
+uproc_seqlock_t* uproc_entry_seqlock(uproc_dentry_t *entry) {
+    return __uproc_seqlock(entry);
+}
+
+void uproc_entry_set_writer_lock(uproc_dentry_t *entry, pthread_mutex_t *lock) {
+    if (entry)
+        entry->writer_lock = lock;
+}
+
+pthread_mutex_t* uproc_entry_writer_lock(uproc_dentry_t *entry) {
+    // declared on the entry the seqlock was set on
+    for (; entry; entry = entry->parent) {
+        if (entry->seqlock)
+            return entry->writer_lock;
+    }
+    return NULL;
+}
+
+/*
+* Calls the read handler of @entry on @b.
+* Entries guarded by a seqlock are rendered again until
+* the values they read were not updated in the meantime.
+*/
+static int __uproc_call_read(uproc_dentry_t *entry, uproc_buf_t *b, off_t offset) {
+    uproc_seqlock_t *sl = __uproc_seqlock(entry);
+    unsigned seq;
+    int done, nread;
+
+    if (!sl)
+        return entry->read_proc(b, &b->done, offset, entry->private_data);
+
+    do {
+        seq = uproc_read_seqbegin(sl);
+        done = b->done;
+        nread = entry->read_proc(b, &done, offset, entry->private_data);
+    } while (uproc_read_seqretry(sl, seq));
+    b->done = done;
+
+    return nread;
+}
+
+/* Calls the render handler of @entry, under its seqlock if any */
+static int __uproc_call_render(uproc_dentry_t *entry, uproc_strbuf_t *out) {
+    uproc_seqlock_t *sl = __uproc_seqlock(entry);
+    size_t len = out->len;
+    unsigned seq;
+    int ret;
+
+    if (!sl)
+        return entry->render_proc(out, entry->private_data);
+
+    do {
+        seq = uproc_read_seqbegin(sl);
+        out->len = len;
+        ret = entry->render_proc(out, entry->private_data);
+    } while (uproc_read_seqretry(sl, seq));
+
+    return ret;
+}
+
+/*
+* How long a request waits for the answer to @entry: its budget, unless that only logs,
+* otherwise UPROC_ASYNC_TIMEOUT_MS.
+*/
+static uint64_t __uproc_async_timeout(uproc_dentry_t *entry) {
+    struct uproc_budget *b = __uproc_budget_active(entry);
+    uint64_t timeout;
+
+    if (b && __uproc_budget_policy(b) != UPROC_BUDGET_LOG &&
+        (timeout = __atomic_load_n(&b->budget, __ATOMIC_RELAXED)))
+        return timeout;
+    return UPROC_ASYNC_TIMEOUT_MS * 1000000ULL;
+}
+
+/*
+* Hands a request over to the asynchronous handler of @entry and waits for its answer.
+* @in: the bytes written, NULL for reads, whose answer is appended to @out.
+* A request not answered in time fails with -ETIMEDOUT, the owner may still complete
+* the token later, it is released by whichever side lets go of it last.
+*/
+static int __uproc_call_async(uproc_dentry_t *entry, const char *in, size_t len,
+                              uproc_strbuf_t *out) {
+    pthread_condattr_t attr;
+    struct timespec ts;
+    uint64_t deadline;
+    uproc_token_t *t;
+    char path[256];
+    int ret;
+
+    t = malloc(sizeof(*t) + len);
+    if (!t)
+        return -ENOMEM;
+    memset(t, 0, sizeof(*t));
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&t->completed, &attr);
+    pthread_condattr_destroy(&attr);
+    // one reference for this thread, one for the completing one
+    t->refs = 2;
+    t->write = in != NULL;
+    t->len = len;
+    if (len)
+        memcpy(t->in, in, len);
+
+    ret = entry->async_proc(t, in ? t->in : NULL, len, entry->private_data);
+    if (ret < 0) {
+        t->refs = 1;
+        __uproc_token_put(t);
+        return ret;
+    }
+
+    deadline = __uproc_now_ns() + __uproc_async_timeout(entry);
+    ts.tv_sec = deadline / 1000000000ULL;
+    ts.tv_nsec = deadline % 1000000000ULL;
+    pthread_mutex_lock(&t->lock);
+    while (!t->done) {
+        // a token the owner never completes must not pin this thread, nor the loop with it
+        if (pthread_cond_timedwait(&t->completed, &t->lock, &ts) == ETIMEDOUT && !t->done)
+            break;
+    }
+    if (t->done) {
+        ret = t->ret;
+        if (!ret && out)
+            ret = uproc_strbuf_append(out, t->out.data, t->out.len);
+    } else {
+        ret = -ETIMEDOUT;
+    }
+    pthread_mutex_unlock(&t->lock);
+    __uproc_token_put(t);
+
+    if (ret == -ETIMEDOUT) {
+        if (uproc_entry_path(entry, path, sizeof(path)) < 0)
+            snprintf(path, sizeof(path), ".../%s", entry->name);
+        fprintf(stderr, "uproc: \"/%s\" was not answered in time\n", path);
+    }
+    return ret;
+}
+
+static void __uproc_token_done(uproc_token_t *token, int ret) {
+    pthread_mutex_lock(&token->lock);
+    token->ret = ret;
+    token->done = 1;
+    pthread_cond_signal(&token->completed);
+    pthread_mutex_unlock(&token->lock);
+    __uproc_token_put(token);
+}
+
+int uproc_complete(uproc_token_t *token, const void *data, size_t len) {
+    int ret = 0;
+
+    if (!token)
+        return -EINVAL;
+    // only the completing thread touches @out until @done is set
+    if (!token->write && len && data)
+        ret = uproc_strbuf_append(&token->out, (const char *)data, len);
+    __uproc_token_done(token, ret);
+    return ret;
+}
+
+void uproc_complete_error(uproc_token_t *token, int err) {
+    if (token)
+        __uproc_token_done(token, err < 0 ? err : -EIO);
+}
+
+uproc_dentry_t* uproc_create_entry_async(uproc_ctx_t *ctx,
+                                         const char *name,
+                                         mode_t mode,
+                                         uproc_dentry_t* parent,
+                                         uproc_async_proc_t async_proc,
+                                         void *private_data) {
+    uproc_dentry_t *ent;
+
+    if (!async_proc) {
+        _SET_UPROC_ERRNO(-EINVAL);
+        return NULL;
+    }
+    ent = uproc_entry_prepare(ctx, name, mode, 0, parent, NULL, NULL, private_data);
+    if (!ent)
+        return NULL;
+    ent->async_proc = async_proc;
+    return uproc_entry_commit(ctx, ent) ? NULL : ent;
+}
+
+/* appends the whole content of @entry to @out, calling its handlers */
+static int __uproc_render_content(uproc_dentry_t *entry, uproc_strbuf_t *out) {
+    struct uproc_published *p;
+    uproc_buf_t b;
+    off_t offset = 0;
+    int nread;
+
+    if ((p = __uproc_published_get(entry))) {
+        nread = uproc_strbuf_append(out, p->data, p->len);
+        __uproc_published_put(p);
+        return nread;
+    }
+    if (entry->render_proc)
+        return __uproc_call_render(entry, out);
+    if (entry->async_proc)
+        return __uproc_call_async(entry, NULL, 0, out);
+    if (!entry->read_proc) {
+        _SET_UPROC_ERRNO(-ENOSYS);
+        return -ENOSYS;
+    }
+
+    // read the entry in slices of at most 64K, until EOF or the handler is done
+    memset(&b, 0, sizeof(b));
+    b.entry = entry;
+    while (!b.done && offset < entry->size) {
+        b.size = entry->size - offset;
+        if (b.size > 65536)
+            b.size = 65536;
+        if (uproc_strbuf_reserve(out, b.size)) {
+            _SET_UPROC_ERRNO(-ENOMEM);
+            return -ENOMEM;
+        }
+        b.mem = out->data + out->len;
+        nread = __uproc_call_read(entry, &b, offset);
+        if (nread < 0) {
+            _SET_UPROC_ERRNO(nread);
+            return nread;
+        }
+        if (nread == 0)
+            break;
+        if (nread > b.size)
+            nread = b.size;
+        out->len += nread;
+        offset += nread;
+    }
+
+    _SET_UPROC_ERRNO(-0);
+    return 0;
+}
+
+static inline uint64_t __cpu_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* accounts for a handler call of @cost which started at @start, see __cpu_ns() */
+static void __uproc_cost_add(uproc_cost_t *cost, int write, uint64_t bytes, uint64_t start) {
+    uint64_t d = __cpu_ns() - start, max;
+
+    __atomic_add_fetch(write ? &cost->writes : &cost->reads, 1, __ATOMIC_RELAXED);
+    if (bytes)
+        __atomic_add_fetch(&cost->bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&cost->cpu_ns, d, __ATOMIC_RELAXED);
+    max = __atomic_load_n(&cost->max_ns, __ATOMIC_RELAXED);
+    while (d > max && !__atomic_compare_exchange_n(&cost->max_ns, &max, d, 1,
+                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+/*
+* Called before a handler of an entry with budget @b, @start is set to the time of the call.
+* returns 0 if the handler may be called, -EAGAIN if it is short-circuited.
+*/
+static int __uproc_budget_enter(struct uproc_budget *b, uint64_t *start) {
+    uint64_t budget = __atomic_load_n(&b->budget, __ATOMIC_RELAXED), now, none = 0;
+    uint64_t since = __atomic_load_n(&b->busy_since, __ATOMIC_RELAXED);
+    uint64_t tripped = __atomic_load_n(&b->tripped, __ATOMIC_RELAXED);
+
+    // taken after the loads, timestamps set by other readers in the meantime may still be
+    // a bit ahead of it, hence the signed differences
+    now = __uproc_now_ns();
+    *start = now;
+    if (budget && __uproc_budget_policy(b) != UPROC_BUDGET_LOG) {
+        // a call stuck over budget holds up this one too, don't wait for it
+        if ((since && (int64_t)(now - since) > (int64_t)budget) ||
+            (tripped && (int64_t)(now - tripped) < (int64_t)__BUDGET_COOLDOWN))
+            return -EAGAIN;
+    }
+    __atomic_compare_exchange_n(&b->busy_since, &none, now, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static void __uproc_budget_leave(uproc_dentry_t *entry, struct uproc_budget *b, uint64_t start) {
+    uint64_t now = __uproc_now_ns(), since = start;
+    uint64_t budget = __atomic_load_n(&b->budget, __ATOMIC_RELAXED);
+    char path[256];
+    unsigned strikes;
+
+    __atomic_compare_exchange_n(&b->busy_since, &since, 0, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    // a budget turned off during the call
+    if (!budget || now - start <= budget) {
+        if (__atomic_load_n(&b->strikes, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&b->strikes, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&b->tripped, 0, __ATOMIC_RELAXED);
+        }
+        return;
+    }
+
+    __atomic_add_fetch(&b->nslow, 1, __ATOMIC_RELAXED);
+    strikes = __atomic_add_fetch(&b->strikes, 1, __ATOMIC_RELAXED);
+    if (uproc_entry_path(entry, path, sizeof(path)) < 0)
+        snprintf(path, sizeof(path), ".../%s", entry->name);
+    fprintf(stderr, "uproc: handler of \"/%s\" took %llu ms, over its budget of %llu ms\n", path,
+            (unsigned long long)(now - start) / 1000000, (unsigned long long)budget / 1000000);
+    if (__uproc_budget_policy(b) != UPROC_BUDGET_LOG && strikes >= __BUDGET_STRIKES) {
+        __atomic_store_n(&b->tripped, now, __ATOMIC_RELAXED);
+        fprintf(stderr, "uproc: \"/%s\" is short-circuited after %u slow calls\n", path, strikes);
+    }
+}
+
+/* appends the whole content of @entry to @out, within its budget if any */
+static int __uproc_render(uproc_dentry_t *entry, uproc_strbuf_t *out) {
+    struct uproc_budget *b = __uproc_budget_active(entry);
+    size_t len = out->len;
+    uint64_t start, cpu;
+    int ret, policy;
+
+    if (!b && !entry->cost)
+        return __uproc_render_content(entry, out);
+    if (!b) {
+        cpu = __cpu_ns();
+        ret = __uproc_render_content(entry, out);
+        __uproc_cost_add(entry->cost, 0, out->len - len, cpu);
+        return ret;
+    }
+    policy = __uproc_budget_policy(b);
+    if ((ret = __uproc_budget_enter(b, &start))) {
+        if (policy == UPROC_BUDGET_STALE) {
+            pthread_mutex_lock(&b->lock);
+            if (b->has_last)
+                ret = uproc_strbuf_append(out, b->last.data, b->last.len);
+            pthread_mutex_unlock(&b->lock);
+        }
+        _SET_UPROC_ERRNO(ret);
+        return ret;
+    }
+    cpu = entry->cost ? __cpu_ns() : 0;
+    ret = __uproc_render_content(entry, out);
+    if (entry->cost)
+        __uproc_cost_add(entry->cost, 0, out->len - len, cpu);
+    __uproc_budget_leave(entry, b, start);
+
+    if (!ret && policy == UPROC_BUDGET_STALE) {
+        pthread_mutex_lock(&b->lock);
+        b->last.len = 0;
+        b->has_last = !uproc_strbuf_append(&b->last, out->data + len, out->len - len);
+        pthread_mutex_unlock(&b->lock);
+    }
+    return ret;
+}
+
+/* calls the read handler of @entry on @b, within its budget if any */
+static int __uproc_timed_read(uproc_dentry_t *entry, uproc_buf_t *b, off_t offset) {
+    struct uproc_budget *bgt = __uproc_budget_active(entry);
+    uint64_t start, cpu;
+    int nread;
+
+    if (!bgt && !entry->cost)
+        return __uproc_call_read(entry, b, offset);
+    if (bgt && (nread = __uproc_budget_enter(bgt, &start)))
+        return nread;
+    cpu = entry->cost ? __cpu_ns() : 0;
+    nread = __uproc_call_read(entry, b, offset);
+    if (entry->cost)
+        __uproc_cost_add(entry->cost, 0, nread > 0 ? nread : 0, cpu);
+    if (bgt)
+        __uproc_budget_leave(entry, bgt, start);
+    return nread;
+}
+
+int uproc_entry_set_budget(uproc_dentry_t *entry, unsigned budget_ms, int policy) {
+    struct uproc_budget *b, *expected = NULL;
+
+    if (!entry || S_ISDIR(entry->mode) || policy < UPROC_BUDGET_LOG || policy > UPROC_BUDGET_STALE)
+        return -EINVAL;
+    /*
+    * Without a budget the struct is left alone rather than freed, readers may be using it.
+    * Concurrent calls may both make one, the first one sets it.
+    */
+    if (!(b = __atomic_load_n(&entry->budget, __ATOMIC_ACQUIRE))) {
+        if (!budget_ms)
+            return 0;
+        b = malloc(sizeof(*b));
+        if (!b)
+            return -ENOMEM;
+        memset(b, 0, sizeof(*b));
+        pthread_mutex_init(&b->lock, NULL);
+        if (!__atomic_compare_exchange_n(&entry->budget, &expected, b, 0,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            __uproc_budget_free(b);
+            b = expected;
+        }
+    }
+    // a new budget gives the handler a fresh start
+    __atomic_store_n(&b->strikes, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&b->tripped, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&b->policy, policy, __ATOMIC_RELAXED);
+    __atomic_store_n(&b->budget, (uint64_t)budget_ms * 1000000, __ATOMIC_RELEASE);
+    return 0;
+}
+
+unsigned long uproc_entry_slow_calls(uproc_dentry_t *entry) {
+    struct uproc_budget *b;
+
+    if (!entry || !(b = __atomic_load_n(&entry->budget, __ATOMIC_ACQUIRE)))
+        return 0;
+    return __atomic_load_n(&b->nslow, __ATOMIC_RELAXED);
+}
+
+/*
+* Serves @entry from its cache while it is fresh, otherwise renders it
+* and keeps a copy for the next @ttl.
+* Renders are single-flight: readers which miss while a render is in progress
+* wait for it and share its result instead of calling the handler again.
+*/
+static int __uproc_cache_render(uproc_dentry_t *entry, struct uproc_cache *c,
+                                uproc_strbuf_t *out) {
+    uproc_strbuf_t fresh, tmp;
+    uint64_t now = __uproc_now_ns();
+    unsigned gen, n;
+    int ret = 0;
+
+    memset(&fresh, 0, sizeof(fresh));
+    pthread_mutex_lock(&c->lock);
+    if (c->valid && now - c->ts < c->ttl)
+        goto copy;
+    if (c->rendering) {
+        n = c->nrenders;
+        while (c->nrenders == n)
+            pthread_cond_wait(&c->rendered, &c->lock);
+        ret = c->ret;
+        goto copy;
+    }
+    c->rendering = 1;
+    gen = c->gen;
+    pthread_mutex_unlock(&c->lock);
+
+    ret = __uproc_render(entry, &fresh);
+
+    pthread_mutex_lock(&c->lock);
+    tmp = c->data;
+    c->data = fresh;
+    fresh = tmp;
+    c->ret = ret;
+    // an invalidation while rendering means the content may be stale already
+    c->valid = !ret && gen == c->gen;
+    c->ts = now;
+    c->rendering = 0;
+    ++c->nrenders;
+    pthread_cond_broadcast(&c->rendered);
+copy:
+    if (!ret)
+        ret = uproc_strbuf_append(out, c->data.data, c->data.len);
+    pthread_mutex_unlock(&c->lock);
+    uproc_strbuf_free(&fresh);
+    return ret;
+}
+
+static struct uproc_cache* __uproc_cache_get(uproc_dentry_t *entry) {
+    struct uproc_cache *c = __atomic_load_n(&entry->cache, __ATOMIC_ACQUIRE), *expected = NULL;
+
+    if (c)
+        return c;
+    c = malloc(sizeof(*c));
+    if (!c)
+        return NULL;
+    memset(c, 0, sizeof(*c));
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->rendered, NULL);
+    // concurrent calls may get here for the same entry, the first one sets it
+    if (!__atomic_compare_exchange_n(&entry->cache, &expected, c, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        __uproc_cache_free(c);
+        c = expected;
+    }
+    return c;
+}
+
+int uproc_render_entry(uproc_dentry_t *entry, uproc_strbuf_t *out) {
+    struct uproc_cache *c;
+
+    if (!entry || !out) {
+        _SET_UPROC_ERRNO(-EINVAL);
+        return -EINVAL;
+    }
+    if (S_ISDIR(entry->mode)) {
+        _SET_UPROC_ERRNO(-EISDIR);
+        return -EISDIR;
+    }
+    if ((c = __uproc_cache_active(entry)))
+        return __uproc_cache_render(entry, c, out);
+    return __uproc_render(entry, out);
+}
+
+int uproc_entry_set_cache_ttl(uproc_dentry_t *entry, unsigned ttl_ms) {
+    struct uproc_cache *c;
+
+    if (!entry || S_ISDIR(entry->mode) || (entry->flags & UPROC_DENTRY_QUERY))
+        return -EINVAL;
+
+    /*
+    * Without a ttl a cache is left alone rather than freed, readers may be using it.
+    * Only single-flight entries keep being served from it, to share renders in flight.
+    */
+    if (!ttl_ms && !(c = __atomic_load_n(&entry->cache, __ATOMIC_ACQUIRE)))
+        return 0;
+    if (ttl_ms && !(c = __uproc_cache_get(entry)))
+        return -ENOMEM;
+    pthread_mutex_lock(&c->lock);
+    __atomic_store_n(&c->ttl, (uint64_t)ttl_ms * 1000000, __ATOMIC_RELAXED);
+    c->valid = 0;
+    pthread_mutex_unlock(&c->lock);
+    return 0;
+}
+
+int uproc_entry_set_assembled(uproc_dentry_t *entry) {
+    if (!entry || S_ISDIR(entry->mode) || (entry->flags & UPROC_DENTRY_QUERY))
+        return -EINVAL;
+    entry->flags |= UPROC_DENTRY_ASSEMBLE;
+    return 0;
+}
+
+int uproc_entry_set_single_flight(uproc_dentry_t *entry) {
+    if (!entry || S_ISDIR(entry->mode) || (entry->flags & UPROC_DENTRY_QUERY))
+        return -EINVAL;
+    if (!__uproc_cache_get(entry))
+        return -ENOMEM;
+    entry->flags |= UPROC_DENTRY_SINGLE_FLIGHT;
+    return 0;
+}
+
+int uproc_publish(uproc_dentry_t *entry, const void *data, size_t len) {
+    struct uproc_published *p, *old;
+
+    if (!entry || S_ISDIR(entry->mode) || (!data && len))
+        return -EINVAL;
+    p = malloc(sizeof(*p) + len);
+    if (!p)
+        return -ENOMEM;
+    p->refs = 1;
+    p->len = len;
+    if (len)
+        memcpy(p->data, data, len);
+
+    __uproc_publock(entry);
+    old = entry->published;
+    __atomic_store_n(&entry->published, p, __ATOMIC_RELEASE);
+    __uproc_pubunlock(entry);
+
+    __uproc_published_put(old);
+    uproc_entry_invalidate(entry);
+    return 0;
+}
+
+uproc_dentry_t* uproc_create_entry_publish(uproc_ctx_t *ctx,
+                                           const char *name,
+                                           mode_t mode,
+                                           uproc_dentry_t* parent) {
+    uproc_dentry_t *ent = uproc_create_entry(ctx, name, mode, 0, parent, NULL, NULL, NULL);
+
+    if (ent && uproc_publish(ent, NULL, 0)) {
+        if (ctx->dbg)
+            fprintf(stderr, "uproc: memory shortage, can't publish \"%s\"\n", name);
+    }
+    return ent;
+}
+
+void uproc_entry_invalidate(uproc_dentry_t *entry) {
+    struct uproc_cache *c;
+
+    if (!entry || !(c = __atomic_load_n(&entry->cache, __ATOMIC_ACQUIRE)))
+        return;
+    pthread_mutex_lock(&c->lock);
+    c->valid = 0;
+    ++c->gen;
+    pthread_mutex_unlock(&c->lock);
+}
+
+int uproc_read_entry(uproc_dentry_t *entry, char *mem, size_t size) {
+    uproc_strbuf_t out;
+    uproc_buf_t b;
+    int nread;
+
+    if (!entry) {
+        _SET_UPROC_ERRNO(-EINVAL);
+        return -EINVAL;
+    }
+    if (S_ISDIR(entry->mode)) {
+        _SET_UPROC_ERRNO(-EISDIR);
+        return -EISDIR;
+    }
+    if (__uproc_is_rendered(entry)) {
+        memset(&out, 0, sizeof(out));
+        nread = uproc_render_entry(entry, &out);
+        if (nread == 0) {
+            nread = out.len > size ? size : out.len;
+            if (nread)
+                memcpy(mem, out.data, nread);
+        }
+        uproc_strbuf_free(&out);
+        _SET_UPROC_ERRNO(nread);
+        return nread;
+    }
+    if (!entry->read_proc) {
+        _SET_UPROC_ERRNO(-ENOSYS);
+        return -ENOSYS;
+    }
+
+    memset(&b, 0, sizeof(b));
+    b.entry = entry;
+    b.mem = mem;
+    b.size = size > entry->size ? entry->size : size;
+    nread = __uproc_timed_read(entry, &b, 0);
+
+    // careful, @nread might be a error number
+    if (nread > 0 && nread > b.size)
+        nread = b.size;
+    _SET_UPROC_ERRNO(nread);
+    return nread;
+}
+
 static int uproc_read(const char *path, char *buf, size_t size, off_t offset,
               struct fuse_file_info *fi)
 {
@@ -550,6 +1427,38 @@ static int uproc_read(const char *path, char *buf, size_t size, off_t offset,
         return -EISDIR;
     }
 
+    if (__uproc_is_rendered(entry) || (entry->flags & UPROC_DENTRY_QUERY)) {
+        /*
+        * render the whole content at the first read, then serve it in slices.
+        * Handles are not seekable and the query file is written first,
+        * so @out is served from the offset of the read which rendered it.
+        */
+        if (!b->done) {
+            b->out.len = 0;
+            if (entry->flags & UPROC_DENTRY_QUERY)
+                nread = uproc_query((uproc_ctx_t*)entry->private_data,
+                                    b->in.data, b->in.len, &b->out);
+            else
+                nread = uproc_render_entry(entry, &b->out);
+            if (nread) {
+                _SET_UPROC_ERRNO(nread);
+                return nread;
+            }
+            b->done = 1;
+            b->answered = 1;
+            b->base = offset;
+        }
+        offset -= b->base;
+        if (offset >= b->out.len) {
+            // EOF, reading on renders fresh content
+            b->done = 0;
+            return 0;
+        }
+        nread = b->out.len - offset > size ? size : b->out.len - offset;
+        memcpy(buf, b->out.data + offset, nread);
+        return nread;
+    }
+
     if (!entry->read_proc) {
         _SET_UPROC_ERRNO(-ENOSYS);
         return -ENOSYS;
@@ -560,17 +1469,55 @@ static int uproc_read(const char *path, char *buf, size_t size, off_t offset,
             size = entry->size - offset;
         b->mem = buf;
         b->size = size;
-        nread = entry->read_proc(b, &b->done, offset, entry->private_data);
+        nread = __uproc_timed_read(entry, b, offset);
     }
 
     // careful, @nread might be a error number
     if (nread > 0 && nread > entry->size)
         nread = entry->size;
+    if (nread > 0 && nread > size)
+        nread = size;
 
     _SET_UPROC_ERRNO(nread);
     return nread;
 }
 
+/* hands the bytes written to @b to the write handler of @entry */
+static int __uproc_call_write(uproc_dentry_t *entry, uproc_buf_t *b, const char *buf, size_t size,
+                              off_t offset) {
+    int written;
+
+    if (entry->async_proc) {
+        // asynchronous writes are accepted or refused as a whole
+        written = __uproc_call_async(entry, buf, size, NULL);
+        return written ? written : (int)size;
+    }
+    b->mem = (char*)buf;
+    b->size = size;
+    return entry->write_proc(b, &b->done, offset, entry->private_data);
+}
+
+/* calls the write handler of @entry within its budget, accounting for its cost */
+static int __uproc_write_accounted(uproc_dentry_t *entry, uproc_buf_t *b, const char *buf,
+                                   size_t size, off_t offset) {
+    struct uproc_budget *bgt = __uproc_budget_active(entry);
+    uint64_t start, cpu;
+    int written;
+
+    if (bgt && (written = __uproc_budget_enter(bgt, &start)))
+        return written;
+    cpu = entry->cost ? __cpu_ns() : 0;
+    written = __uproc_call_write(entry, b, buf, size, offset);
+    if (entry->cost)
+        __uproc_cost_add(entry->cost, 1, 0, cpu);
+    if (bgt)
+        __uproc_budget_leave(entry, bgt, start);
+
+    if (written > 0)
+        uproc_entry_invalidate(entry);
+    return written;
+}
+
 static int uproc_write(const char * path, const char *buf, size_t size, off_t offset,
                        struct fuse_file_info *fi) {
     uproc_buf_t    *b = (uproc_buf_t*)fi->fh;;
@@ -592,26 +1539,72 @@ static int uproc_write(const char * path, const char *buf, size_t size, off_t of
         return -EISDIR;
     }
 
-    if (!entry->write_proc) {
+    if (entry->flags & UPROC_DENTRY_QUERY) {
+        // a write after the answer was read starts a new query
+        if (b->answered) {
+            b->in.len = 0;
+            b->answered = 0;
+        }
+        b->done = 0;
+        if (b->in.len + size > UPROC_QUERY_MAX) {
+            _SET_UPROC_ERRNO(-EFBIG);
+            return -EFBIG;
+        }
+        if (uproc_strbuf_append(&b->in, buf, size)) {
+            _SET_UPROC_ERRNO(-ENOMEM);
+            return -ENOMEM;
+        }
+        return size;
+    }
+
+    if (!entry->write_proc && !entry->async_proc) {
         _SET_UPROC_ERRNO(-ENOSYS);
         return -ENOSYS;
     }
-
-    if (entry->write_proc && !b->done) {
-        b->mem = (char*)buf;
-        b->size = size;
-        written = entry->write_proc(b, &b->done, offset, entry->private_data);
-    } else {
+    if (entry->flags & UPROC_DENTRY_ASSEMBLE) {
+        // the handle is nonseekable, the chunks come in order
+        if ((size_t)offset != b->in.len) {
+            _SET_UPROC_ERRNO(-ESPIPE);
+            return -ESPIPE;
+        }
+        if (b->in.len + size > (entry->size ? entry->size : UPROC_QUERY_MAX)) {
+            _SET_UPROC_ERRNO(-EFBIG);
+            return -EFBIG;
+        }
+        if (uproc_strbuf_append(&b->in, buf, size)) {
+            _SET_UPROC_ERRNO(-ENOMEM);
+            return -ENOMEM;
+        }
         return size;
     }
+    if (b->done)
+        return size;
+
+    written = __uproc_write_accounted(entry, b, buf, size, offset);
 
     // careful, @written might be a error number
-    if (written > 0 && written > entry->size)
+    if (written > 0 && written > entry->size && !entry->async_proc)
         written = entry->size;
     _SET_UPROC_ERRNO(written);
     return written;
 }
 
+/* delivers what was written to a handle of an assembled entry, as one write at offset 0 */
+static int uproc_flush(const char *path, struct fuse_file_info *fi) {
+    uproc_buf_t *b = (uproc_buf_t*)fi->fh;
+    int ret;
+
+    // flush comes with every close() of the handle, only the first one delivers
+    if (!b || !b->entry || !(b->entry->flags & UPROC_DENTRY_ASSEMBLE) || !b->in.len)
+        return 0;
+    b->done = 0;
+    ret = __uproc_write_accounted(b->entry, b, b->in.data, b->in.len, 0);
+    b->in.len = 0;
+    ret = ret < 0 ? ret : 0;
+    _SET_UPROC_ERRNO(ret);
+    return ret;
+}
+
 int uproc_truncate(const char *path, off_t offset) {
     return 0;
 }
@@ -619,6 +1612,9 @@ int uproc_truncate(const char *path, off_t offset) {
 static uproc_ctx_t  *uproc_instance;
 static char *argv[] = {"uproc", "-s", "-d", "./uproc"};
 static int argc = sizeof(argv) / sizeof(char *);
+// without "-s", fuse runs a thread per request in flight
+static char *argv_mt[] = {"uproc", "-d", "./uproc"};
+static int argc_mt = sizeof(argv_mt) / sizeof(char *);
 
 static void* uproc_init(struct fuse_conn_info *conn) {
     return (void*)uproc_instance;
@@ -634,25 +1630,136 @@ static struct fuse_operations uproc_ops = {
     .releasedir = uproc_releasedir,
     .read       = uproc_read,
     .write      = uproc_write,
+    .flush      = uproc_flush,
     .truncate   = uproc_truncate,
 };
 
-int uproc_run(uproc_ctx_t *ctx) {
+/*
+* With uproc_enable_stats(), the operations are served through these wrappers
+* which time them and count the handles, the plain ones above cost nothing extra.
+*/
+static inline void __uproc_stats_op(uproc_op_t op, uint64_t start) {
+    uproc_stats_t *st = uproc_instance->stats;
+    uint64_t d = __uproc_now_ns() - start;
+
+    uproc_hist_record(st->ops[op], d);
+    uproc_counter_add(st->busy_ns, d);
+    // the threads of the loop are made by fuse, their shards are made once they have
+    // recorded their first operation, outside of the time measured
+    uproc_hist_thread_prepare(st->ops[op]);
+}
+
+// accounts for the growth of the buffers of @b
+static inline void __uproc_stats_held(uproc_buf_t *b) {
+    size_t held = b->out.cap + b->in.cap;
+
+    if (held != b->held) {
+        __atomic_add_fetch(&uproc_instance->stats->buffer_bytes, held - b->held, __ATOMIC_RELAXED);
+        b->held = held;
+    }
+}
+
+static int uproc_getattr_timed(const char *path, struct stat *stbuf) {
+    uint64_t start = __uproc_now_ns();
+    int ret = uproc_getattr(path, stbuf);
+
+    __uproc_stats_op(UPROC_OP_GETATTR, start);
+    return ret;
+}
+
+static int uproc_readdir_timed(const char *path, void *buf, fuse_fill_dir_t filler,
+                               off_t offset, struct fuse_file_info *fi) {
+    uint64_t start = __uproc_now_ns();
+    int ret = uproc_readdir(path, buf, filler, offset, fi);
+
+    __uproc_stats_op(UPROC_OP_READDIR, start);
+    return ret;
+}
+
+static int uproc_open_timed(const char *path, struct fuse_file_info *fi) {
+    uproc_stats_t *st = uproc_instance->stats;
+    uint64_t start = __uproc_now_ns();
+    int ret = uproc_open(path, fi);
+
+    if (!ret) {
+        __atomic_add_fetch(&st->handles, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&st->buffer_bytes, sizeof(uproc_buf_t), __ATOMIC_RELAXED);
+    }
+    __uproc_stats_op(UPROC_OP_OPEN, start);
+    return ret;
+}
+
+static int uproc_release_counted(const char *path, struct fuse_file_info *fi) {
+    uproc_stats_t *st = uproc_instance->stats;
+    uproc_buf_t *b = (uproc_buf_t*)fi->fh;
+
+    if (b) {
+        __atomic_sub_fetch(&st->handles, 1, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&st->buffer_bytes, sizeof(uproc_buf_t) + b->held, __ATOMIC_RELAXED);
+    }
+    return uproc_release(path, fi);
+}
+
+static int uproc_read_timed(const char *path, char *buf, size_t size, off_t offset,
+                            struct fuse_file_info *fi) {
+    uint64_t start = __uproc_now_ns();
+    int ret = uproc_read(path, buf, size, offset, fi);
+
+    if (fi->fh)
+        __uproc_stats_held((uproc_buf_t*)fi->fh);
+    __uproc_stats_op(UPROC_OP_READ, start);
+    return ret;
+}
+
+static int uproc_write_timed(const char *path, const char *buf, size_t size, off_t offset,
+                             struct fuse_file_info *fi) {
+    uint64_t start = __uproc_now_ns();
+    int ret = uproc_write(path, buf, size, offset, fi);
+
+    if (fi->fh)
+        __uproc_stats_held((uproc_buf_t*)fi->fh);
+    __uproc_stats_op(UPROC_OP_WRITE, start);
+    return ret;
+}
+
+static struct fuse_operations uproc_ops_timed = {
+    .init       = uproc_init,
+    .getattr    = uproc_getattr_timed,
+    .opendir    = uproc_opendir,
+    .readdir    = uproc_readdir_timed,
+    .open       = uproc_open_timed,
+    .release    = uproc_release_counted,
+    .releasedir = uproc_releasedir,
+    .read       = uproc_read_timed,
+    .write      = uproc_write_timed,
+    .flush      = uproc_flush,
+    .truncate   = uproc_truncate,
+};
+
+static int __uproc_run(uproc_ctx_t *ctx, int mt) {
     struct fuse *fuse;
     char *mountpoint = (char*)ctx->mount_point;
     int multithreaded = 0;
-    int res;
+    int res, i;
 
     argv[3] = (char*)ctx->mount_point;
+    argv_mt[2] = (char*)ctx->mount_point;
     uproc_instance = ctx;
 
-    fuse = fuse_setup(argc, argv, &uproc_ops, sizeof(uproc_ops), &mountpoint,
-                 &multithreaded, NULL);
+    fuse = fuse_setup(mt ? argc_mt : argc, mt ? argv_mt : argv,
+                      ctx->stats ? &uproc_ops_timed : &uproc_ops, sizeof(uproc_ops),
+                      &mountpoint, &multithreaded, NULL);
     if (fuse == NULL)
         return -1;
 
     ctx->fuse = fuse;
-    res = fuse_loop(fuse);
+    // the single-threaded loop serves from this thread, give it its shards up front
+    for (i = 0; ctx->stats && !multithreaded && i < UPROC_OP_MAX; ++i)
+        uproc_hist_thread_prepare(ctx->stats->ops[i]);
+    if (multithreaded)
+        res = fuse_loop_mt(fuse);
+    else
+        res = fuse_loop(fuse);
 
     fuse_teardown(fuse, mountpoint);
 
@@ -661,6 +1768,14 @@ int uproc_run(uproc_ctx_t *ctx) {
     return res;
 }
 
+int uproc_run(uproc_ctx_t *ctx) {
+    return __uproc_run(ctx, 0);
+}
+
+int uproc_run_mt(uproc_ctx_t *ctx) {
+    return __uproc_run(ctx, 1);
+}
+
 /* 
 * Tells uproc to exit.
 */
@@ -1,6 +1,7 @@
 #include <uproc.h>
 
 #include <stdint.h>
+#include <ctype.h>
 #include <float.h>
 #include <limits.h>
 #include <string.h>
@@ -303,18 +304,10 @@ static int __cstring_read_proc(uproc_buf_t *buf, int *done, off_t fileoff, void
 }
 
 
-#define __WRITE_BUF_SIZE 5000
-// buffer for making uproc_buf_t into a null-terminated string.
-static char __write_buf[__WRITE_BUF_SIZE];
-
-static inline void __copy_to_write_buf(uproc_buf_t *buf) {
+// number of bytes of the write request a handler should look at.
+static inline size_t __write_size(uproc_buf_t *buf) {
     uproc_dentry_t *entry = buf->entry;
-    size_t size = buf->size > entry->size ? entry->size : buf->size;
-    if (size > __WRITE_BUF_SIZE - 1) {
-        size = __WRITE_BUF_SIZE - 1;
-    }
-    memcpy(__write_buf, buf->mem, size);
-    __write_buf[size] = '\0';
+    return buf->size > entry->size ? entry->size : buf->size;
 }
 
 static int __uchar_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
@@ -331,38 +324,27 @@ static int __uchar_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *
 static int __ushort_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
     int n = buf->size;
     unsigned short *v = (unsigned short *)private_data;
-    unsigned long int x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    uint64_t x;
+    int ret;
     *done = 1;
 
-    x = strtoul(__write_buf, &endptr, 10);
-
-    if (errno == ERANGE || x > USHRT_MAX) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_uint(buf->mem, __write_size(buf), USHRT_MAX, &x))) {
+        n = ret;
     } else {
         *v = x;
     }
-
     return n;
 }
 
 static int __uint_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
     int n = buf->size;
     unsigned int *v = (unsigned int *)private_data;
-    unsigned long long int x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    uint64_t x;
+    int ret;
     *done = 1;
 
-    x = strtoull(__write_buf, &endptr, 10);
-
-    if (errno == ERANGE || x > UINT_MAX) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_uint(buf->mem, __write_size(buf), UINT_MAX, &x))) {
+        n = ret;
     } else {
         *v = x;
     }
@@ -372,17 +354,12 @@ static int __uint_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *p
 static int __ulong_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
     int n = buf->size;
     unsigned long *v = (unsigned long *)private_data;
-    unsigned long long int x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    uint64_t x;
+    int ret;
     *done = 1;
 
-    x = strtoull(__write_buf, &endptr, 10);
-
-    if (errno == ERANGE || x > ULONG_MAX) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_uint(buf->mem, __write_size(buf), ULONG_MAX, &x))) {
+        n = ret;
     } else {
         *v = x;
     }
@@ -392,17 +369,12 @@ static int __ulong_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *
 static int __ullong_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
     int n = buf->size;
     unsigned long long *v = (unsigned long long *)private_data;
-    unsigned long long int x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    uint64_t x;
+    int ret;
     *done = 1;
 
-    x = strtoull(__write_buf, &endptr, 10);
-
-    if (errno == ERANGE) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_uint(buf->mem, __write_size(buf), ULLONG_MAX, &x))) {
+        n = ret;
     } else {
         *v = x;
     }
@@ -412,38 +384,27 @@ static int __ullong_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void
 static int __uint16_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
     int n = buf->size;
     uint16_t *v = (uint16_t *)private_data;
-    unsigned long int x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    uint64_t x;
+    int ret;
     *done = 1;
 
-    x = strtoul(__write_buf, &endptr, 10);
-
-    if (errno == ERANGE || x > UINT16_MAX) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_uint(buf->mem, __write_size(buf), UINT16_MAX, &x))) {
+        n = ret;
     } else {
         *v = x;
     }
-
     return n;
 }
 
 static int __uint32_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
     int n = buf->size;
     uint32_t *v = (uint32_t *)private_data;
-    unsigned long long int x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    uint64_t x;
+    int ret;
     *done = 1;
 
-    x = strtoull(__write_buf, &endptr, 10);
-
-    if (errno == ERANGE || x > UINT32_MAX) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_uint(buf->mem, __write_size(buf), UINT32_MAX, &x))) {
+        n = ret;
     } else {
         *v = x;
     }
@@ -453,17 +414,12 @@ static int __uint32_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void
 static int __uint64_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
     int n = buf->size;
     uint64_t *v = (uint64_t *)private_data;
-    unsigned long long int x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    uint64_t x;
+    int ret;
     *done = 1;
 
-    x = strtoull(__write_buf, &endptr, 10);
-
-    if (errno == ERANGE || x > UINT64_MAX) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_uint(buf->mem, __write_size(buf), UINT64_MAX, &x))) {
+        n = ret;
     } else {
         *v = x;
     }
@@ -477,17 +433,12 @@ static int __char_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *p
 static int __short_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
     int n = buf->size;
     short *v = (short *)private_data;
-    long int x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    int64_t x;
+    int ret;
     *done = 1;
 
-    x = strtol(__write_buf, &endptr, 10);
-
-    if (errno == ERANGE || x > SHRT_MAX || x < SHRT_MIN) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_int(buf->mem, __write_size(buf), SHRT_MIN, SHRT_MAX, &x))) {
+        n = ret;
     } else {
         *v = x;
     }
@@ -497,17 +448,12 @@ static int __short_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *
 static int __int_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
     int n = buf->size;
     int *v = (int *)private_data;
-    long long int x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    int64_t x;
+    int ret;
     *done = 1;
 
-    x = strtoll(__write_buf, &endptr, 10);
-
-    if (errno == ERANGE || x > INT_MAX || x < INT_MIN) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_int(buf->mem, __write_size(buf), INT_MIN, INT_MAX, &x))) {
+        n = ret;
     } else {
         *v = x;
     }
@@ -517,17 +463,12 @@ static int __int_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *pr
 static int __long_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
     int n = buf->size;
     long *v = (long *)private_data;
-    long long int x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    int64_t x;
+    int ret;
     *done = 1;
 
-    x = strtoll(__write_buf, &endptr, 10);
-
-    if (errno == ERANGE || x > LONG_MAX || x < LONG_MIN) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_int(buf->mem, __write_size(buf), LONG_MIN, LONG_MAX, &x))) {
+        n = ret;
     } else {
         *v = x;
     }
@@ -537,17 +478,12 @@ static int __long_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *p
 static int __llong_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
     int n = buf->size;
     long long *v = (long long *)private_data;
-    long long int x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    int64_t x;
+    int ret;
     *done = 1;
 
-    x = strtoll(__write_buf, &endptr, 10);
-
-    if (errno == ERANGE) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_int(buf->mem, __write_size(buf), LLONG_MIN, LLONG_MAX, &x))) {
+        n = ret;
     } else {
         *v = x;
     }
@@ -558,16 +494,11 @@ static int __float_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *
     int n = buf->size;
     float *v = (float *)private_data;
     float x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    int ret;
     *done = 1;
 
-    x = strtof(__write_buf, &endptr);
-
-    if (errno == ERANGE) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_float(buf->mem, __write_size(buf), &x))) {
+        n = ret;
     } else {
         *v = x;
     }
@@ -578,16 +509,11 @@ static int __double_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void
     int n = buf->size;
     double *v = (double *)private_data;
     double x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    int ret;
     *done = 1;
 
-    x = strtod(__write_buf, &endptr);
-
-    if (errno == ERANGE) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_double(buf->mem, __write_size(buf), &x))) {
+        n = ret;
     } else {
         *v = x;
     }
@@ -598,16 +524,11 @@ static int __ldouble_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void
     int n = buf->size;
     long double *v = (long double *)private_data;
     long double x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    int ret;
     *done = 1;
 
-    x = strtold(__write_buf, &endptr);
-
-    if (errno == ERANGE) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_ldouble(buf->mem, __write_size(buf), &x))) {
+        n = ret;
     } else {
         *v = x;
     }
@@ -617,63 +538,45 @@ static int __ldouble_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void
 static int __int16_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
     int n = buf->size;
     int16_t *v = (int16_t *)private_data;
-    long int x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    int64_t x;
+    int ret;
     *done = 1;
 
-    x = strtol(__write_buf, &endptr, 10);
-
-    if (errno == ERANGE || x > INT16_MAX || x < INT16_MIN) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_int(buf->mem, __write_size(buf), INT16_MIN, INT16_MAX, &x))) {
+        n = ret;
     } else {
         *v = x;
     }
-
     return n;
 }
 
 static int __int32_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
     int n = buf->size;
     int32_t *v = (int32_t *)private_data;
-    long long int x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    int64_t x;
+    int ret;
     *done = 1;
 
-    x = strtoll(__write_buf, &endptr, 10);
-
-    if (errno == ERANGE || x > INT32_MAX || x < INT32_MIN) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_int(buf->mem, __write_size(buf), INT32_MIN, INT32_MAX, &x))) {
+        n = ret;
     } else {
         *v = x;
     }
-
     return n;
 }
 
 static int __int64_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
     int n = buf->size;
     int64_t *v = (int64_t *)private_data;
-    long long int x;
-    char *endptr;
-    __copy_to_write_buf(buf);
+    int64_t x;
+    int ret;
     *done = 1;
 
-    x = strtoll(__write_buf, &endptr, 10);
-
-    if (errno == ERANGE) {
-        n = -ERANGE;
-    } else if (endptr == __write_buf) {
-        n = -EINVAL;
+    if ((ret = uproc_parse_int(buf->mem, __write_size(buf), INT64_MIN, INT64_MAX, &x))) {
+        n = ret;
     } else {
         *v = x;
     }
-
     return n;
 }
 
@@ -686,6 +589,96 @@ static int __string_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void
     return size;
 }
 
+/* handlers and sizes of the primitive types, indexed by uproc_type_t */
+static const struct {
+    uproc_read_proc_t  read_proc;
+    uproc_write_proc_t write_proc;
+    size_t             size;
+} __type_ops[UPROC_TYPE_MAX] = {
+    [UPROC_TYPE_UCHAR]   = { __uchar_read_proc,   __uchar_write_proc,   sizeof(unsigned char) },
+    [UPROC_TYPE_USHORT]  = { __ushort_read_proc,  __ushort_write_proc,  sizeof(unsigned short) },
+    [UPROC_TYPE_UINT]    = { __uint_read_proc,    __uint_write_proc,    sizeof(unsigned int) },
+    [UPROC_TYPE_ULONG]   = { __ulong_read_proc,   __ulong_write_proc,   sizeof(unsigned long) },
+    [UPROC_TYPE_ULLONG]  = { __ullong_read_proc,  __ullong_write_proc,  sizeof(unsigned long long) },
+    [UPROC_TYPE_UINT16]  = { __uint16_read_proc,  __uint16_write_proc,  sizeof(uint16_t) },
+    [UPROC_TYPE_UINT32]  = { __uint32_read_proc,  __uint32_write_proc,  sizeof(uint32_t) },
+    [UPROC_TYPE_UINT64]  = { __uint64_read_proc,  __uint64_write_proc,  sizeof(uint64_t) },
+    [UPROC_TYPE_CHAR]    = { __char_read_proc,    __char_write_proc,    sizeof(char) },
+    [UPROC_TYPE_SHORT]   = { __short_read_proc,   __short_write_proc,   sizeof(short) },
+    [UPROC_TYPE_INT]     = { __int_read_proc,     __int_write_proc,     sizeof(int) },
+    [UPROC_TYPE_LONG]    = { __long_read_proc,    __long_write_proc,    sizeof(long) },
+    [UPROC_TYPE_LLONG]   = { __llong_read_proc,   __llong_write_proc,   sizeof(long long) },
+    [UPROC_TYPE_FLOAT]   = { __float_read_proc,   __float_write_proc,   sizeof(float) },
+    [UPROC_TYPE_DOUBLE]  = { __double_read_proc,  __double_write_proc,  sizeof(double) },
+    [UPROC_TYPE_LDOUBLE] = { __ldouble_read_proc, __ldouble_write_proc, sizeof(long double) },
+    [UPROC_TYPE_INT16]   = { __int16_read_proc,   __int16_write_proc,   sizeof(int16_t) },
+    [UPROC_TYPE_INT32]   = { __int32_read_proc,   __int32_write_proc,   sizeof(int32_t) },
+    [UPROC_TYPE_INT64]   = { __int64_read_proc,   __int64_write_proc,   sizeof(int64_t) },
+};
+
+static inline int __is_primitive(uproc_type_t type) {
+    return type > UPROC_TYPE_NONE && type < UPROC_TYPE_MAX && __type_ops[type].read_proc;
+}
+
+/*
+* Change tracking for the primitive wrappers.
+* Most values are read far more often than they change, so a read compares
+* the current value with the last one formatted and reuses its text when they match.
+*/
+#define __FMT_RAW_MAX  16
+#define __FMT_TEXT_MAX 40
+
+/* a copy of a primitive value, aligned for the handlers which dereference it as its type */
+typedef union {
+    char        bytes[__FMT_RAW_MAX];
+    uint64_t    u64;
+    double      d;
+    long double ld;
+} __raw_value_t;
+
+struct uproc_fmt_cache {
+    uproc_seqlock_t seq;
+    unsigned        len;                   // of @text, 0 until the first read
+    __raw_value_t   raw;
+    char            text[__FMT_TEXT_MAX];
+};
+
+static int __typed_read_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
+    uproc_dentry_t *entry = buf->entry;
+    struct uproc_fmt_cache *fc = entry->fmt;
+    size_t size = __type_ops[entry->type].size;
+    __raw_value_t raw;
+    unsigned seq, len;
+    int n;
+
+    // a single load of the value, it is both compared and formatted from this copy
+    memcpy(raw.bytes, private_data, size);
+    do {
+        seq = uproc_read_seqbegin(&fc->seq);
+        len = fc->len;
+        if (!len || len > sizeof(fc->text) || len > buf->size || memcmp(raw.bytes, fc->raw.bytes, size)) {
+            len = 0;
+            break;
+        }
+        memcpy(buf->mem, fc->text, len);
+    } while (uproc_read_seqretry(&fc->seq, seq));
+    if (len) {
+        *done = 1;
+        return len;
+    }
+
+    n = __type_ops[entry->type].read_proc(buf, done, fileoff, raw.bytes);
+    // truncated text is never kept, a reader racing for the update leaves it to the other one
+    if (n > 0 && (size_t)n < sizeof(fc->text) && buf->size > sizeof(fc->text) &&
+        uproc_write_seqtrybegin(&fc->seq)) {
+        memcpy(fc->raw.bytes, raw.bytes, size);
+        memcpy(fc->text, buf->mem, n);
+        fc->len = n;
+        uproc_write_seqend(&fc->seq);
+    }
+    return n;
+}
+
 static uproc_dentry_t* __uproc_utility_create_internal(uproc_ctx_t *ctx,
                                        const char *name, // name of the entry
                                        mode_t mode,      // permissions
@@ -694,12 +687,26 @@ static uproc_dentry_t* __uproc_utility_create_internal(uproc_ctx_t *ctx,
                                        int readonly,
                                        uproc_read_proc_t read_proc,
                                        uproc_write_proc_t write_proc,
-                                       void *private_data) {
+                                       void *private_data,
+                                       uproc_type_t type) {
+    uproc_dentry_t *ent;
     if (size == 0)
         size = 4096;
     if (readonly)
         write_proc = NULL;
-    return uproc_create_entry(ctx, name, mode, size, parent, read_proc, write_proc, private_data);
+    ent = uproc_entry_prepare(ctx, name, mode, size, parent, read_proc, write_proc, private_data);
+    if (!ent)
+        return NULL;
+    ent->type = type;
+
+    // a missing cache only costs the formatting
+    if (__is_primitive(type) && read_proc == __type_ops[type].read_proc &&
+        __type_ops[type].size <= __FMT_RAW_MAX) {
+        ent->fmt = calloc(1, sizeof(*ent->fmt));
+        if (ent->fmt)
+            ent->read_proc = __typed_read_proc;
+    }
+    return uproc_entry_commit(ctx, ent) ? NULL : ent;
 }
 
 
@@ -716,7 +723,8 @@ uproc_dentry_t* uproc_create_entry_uchar(uproc_ctx_t *ctx,
                                        unsigned char *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                           __uchar_read_proc, __uchar_write_proc, (void*)v);
+                                           __uchar_read_proc, __uchar_write_proc, (void*)v,
+                                       UPROC_TYPE_UCHAR);
 }
 
 uproc_dentry_t* uproc_create_entry_ushort(uproc_ctx_t *ctx,
@@ -727,7 +735,8 @@ uproc_dentry_t* uproc_create_entry_ushort(uproc_ctx_t *ctx,
                                        unsigned short *v
                                    ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __ushort_read_proc, __ushort_write_proc, (void*)v);
+                                       __ushort_read_proc, __ushort_write_proc, (void*)v,
+                                       UPROC_TYPE_USHORT);
 }
 
 uproc_dentry_t* uproc_create_entry_uint(uproc_ctx_t *ctx,
@@ -738,7 +747,8 @@ uproc_dentry_t* uproc_create_entry_uint(uproc_ctx_t *ctx,
                                        unsigned int *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __uint_read_proc, __uint_write_proc, (void*)v);
+                                       __uint_read_proc, __uint_write_proc, (void*)v,
+                                       UPROC_TYPE_UINT);
 }
 
 uproc_dentry_t* uproc_create_entry_ulong(uproc_ctx_t *ctx,
@@ -749,7 +759,8 @@ uproc_dentry_t* uproc_create_entry_ulong(uproc_ctx_t *ctx,
                                        unsigned long *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __ulong_read_proc, __ulong_write_proc, (void*)v);
+                                       __ulong_read_proc, __ulong_write_proc, (void*)v,
+                                       UPROC_TYPE_ULONG);
 }
 
 uproc_dentry_t* uproc_create_entry_ullong(uproc_ctx_t *ctx,
@@ -760,7 +771,8 @@ uproc_dentry_t* uproc_create_entry_ullong(uproc_ctx_t *ctx,
                                        unsigned long long *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __ullong_read_proc, __ullong_write_proc, (void*)v);
+                                       __ullong_read_proc, __ullong_write_proc, (void*)v,
+                                       UPROC_TYPE_ULLONG);
 }
 
 uproc_dentry_t* uproc_create_entry_uint16(uproc_ctx_t *ctx,
@@ -771,7 +783,8 @@ uproc_dentry_t* uproc_create_entry_uint16(uproc_ctx_t *ctx,
                                        uint16_t *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __uint16_read_proc, __uint16_write_proc, (void*)v);
+                                       __uint16_read_proc, __uint16_write_proc, (void*)v,
+                                       UPROC_TYPE_UINT16);
 }
 
 uproc_dentry_t* uproc_create_entry_uint32(uproc_ctx_t *ctx,
@@ -782,7 +795,8 @@ uproc_dentry_t* uproc_create_entry_uint32(uproc_ctx_t *ctx,
                                        uint32_t *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __uint32_read_proc, __uint32_write_proc, (void*)v);
+                                       __uint32_read_proc, __uint32_write_proc, (void*)v,
+                                       UPROC_TYPE_UINT32);
 }
 
 uproc_dentry_t* uproc_create_entry_uint64(uproc_ctx_t *ctx,
@@ -793,7 +807,8 @@ uproc_dentry_t* uproc_create_entry_uint64(uproc_ctx_t *ctx,
                                        uint64_t *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __uint64_read_proc, __uint64_write_proc, (void*)v);
+                                       __uint64_read_proc, __uint64_write_proc, (void*)v,
+                                       UPROC_TYPE_UINT64);
 }
 
 uproc_dentry_t* uproc_create_entry_char(uproc_ctx_t *ctx,
@@ -804,7 +819,8 @@ uproc_dentry_t* uproc_create_entry_char(uproc_ctx_t *ctx,
                                        char *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __char_read_proc, __char_write_proc, (void*)v);
+                                       __char_read_proc, __char_write_proc, (void*)v,
+                                       UPROC_TYPE_CHAR);
 }
 
 uproc_dentry_t* uproc_create_entry_short(uproc_ctx_t *ctx,
@@ -815,7 +831,8 @@ uproc_dentry_t* uproc_create_entry_short(uproc_ctx_t *ctx,
                                        short *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __short_read_proc, __short_write_proc, (void*)v);
+                                       __short_read_proc, __short_write_proc, (void*)v,
+                                       UPROC_TYPE_SHORT);
 }
 
 uproc_dentry_t* uproc_create_entry_int(uproc_ctx_t *ctx,
@@ -826,7 +843,8 @@ uproc_dentry_t* uproc_create_entry_int(uproc_ctx_t *ctx,
                                        int *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __int_read_proc, __int_write_proc, (void*)v);
+                                       __int_read_proc, __int_write_proc, (void*)v,
+                                       UPROC_TYPE_INT);
 }
 
 uproc_dentry_t* uproc_create_entry_long(uproc_ctx_t *ctx,
@@ -837,7 +855,8 @@ uproc_dentry_t* uproc_create_entry_long(uproc_ctx_t *ctx,
                                        long *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __long_read_proc, __long_write_proc, (void*)v);
+                                       __long_read_proc, __long_write_proc, (void*)v,
+                                       UPROC_TYPE_LONG);
 }
 
 uproc_dentry_t* uproc_create_entry_llong(uproc_ctx_t *ctx,
@@ -848,7 +867,8 @@ uproc_dentry_t* uproc_create_entry_llong(uproc_ctx_t *ctx,
                                        long long *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __llong_read_proc, __llong_write_proc, (void*)v);
+                                       __llong_read_proc, __llong_write_proc, (void*)v,
+                                       UPROC_TYPE_LLONG);
 }
 
 uproc_dentry_t* uproc_create_entry_float(uproc_ctx_t *ctx,
@@ -859,7 +879,8 @@ uproc_dentry_t* uproc_create_entry_float(uproc_ctx_t *ctx,
                                        float *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __float_read_proc, __float_write_proc, (void*)v);
+                                       __float_read_proc, __float_write_proc, (void*)v,
+                                       UPROC_TYPE_FLOAT);
 }
 
 uproc_dentry_t* uproc_create_entry_double(uproc_ctx_t *ctx,
@@ -870,7 +891,8 @@ uproc_dentry_t* uproc_create_entry_double(uproc_ctx_t *ctx,
                                        double *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __double_read_proc, __double_write_proc, (void*)v);
+                                       __double_read_proc, __double_write_proc, (void*)v,
+                                       UPROC_TYPE_DOUBLE);
 }
 
 uproc_dentry_t* uproc_create_entry_ldouble(uproc_ctx_t *ctx,
@@ -881,7 +903,8 @@ uproc_dentry_t* uproc_create_entry_ldouble(uproc_ctx_t *ctx,
                                        long double *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __ldouble_read_proc, __ldouble_write_proc, (void*)v);
+                                       __ldouble_read_proc, __ldouble_write_proc, (void*)v,
+                                       UPROC_TYPE_LDOUBLE);
 }
 
 uproc_dentry_t* uproc_create_entry_int16(uproc_ctx_t *ctx,
@@ -892,7 +915,8 @@ uproc_dentry_t* uproc_create_entry_int16(uproc_ctx_t *ctx,
                                        int16_t *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __int16_read_proc, __int16_write_proc, (void*)v);
+                                       __int16_read_proc, __int16_write_proc, (void*)v,
+                                       UPROC_TYPE_INT16);
 }
 
 uproc_dentry_t* uproc_create_entry_int32(uproc_ctx_t *ctx,
@@ -903,7 +927,8 @@ uproc_dentry_t* uproc_create_entry_int32(uproc_ctx_t *ctx,
                                        int32_t *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __int32_read_proc, __int32_write_proc, (void*)v);
+                                       __int32_read_proc, __int32_write_proc, (void*)v,
+                                       UPROC_TYPE_INT32);
 }
 
 uproc_dentry_t* uproc_create_entry_int64(uproc_ctx_t *ctx,
@@ -914,7 +939,8 @@ uproc_dentry_t* uproc_create_entry_int64(uproc_ctx_t *ctx,
                                        int64_t *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                       __int64_read_proc, __int64_write_proc, (void*)v);
+                                       __int64_read_proc, __int64_write_proc, (void*)v,
+                                       UPROC_TYPE_INT64);
 }
 
 // wrapper for const char *, it's readonly by definition.
@@ -926,7 +952,8 @@ uproc_dentry_t* uproc_create_entry_cstring(uproc_ctx_t *ctx,
                                        const char *v
                                        ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, /* readonly */ 1,
-                                       __cstring_read_proc, /* write_proc */ NULL, (void*)v);
+                                       __cstring_read_proc, /* write_proc */ NULL, (void*)v,
+                                       UPROC_TYPE_NONE);
 }
 
 // wrapper for char *.
@@ -942,5 +969,477 @@ uproc_dentry_t* uproc_create_entry_string(uproc_ctx_t *ctx,
                                            char *v
                                            ) {
     return __uproc_utility_create_internal(ctx, name, mode, 0, parent, readonly,
-                                   __cstring_read_proc, __string_write_proc, (void*)v);
-}
\ No newline at end of file
+                                   __cstring_read_proc, __string_write_proc, (void*)v,
+                                   UPROC_TYPE_NONE);
+}
+typedef struct {
+    char                *base;
+    size_t               nfields;
+    uproc_field_t        fields[];
+} __struct_t;
+
+/*
+* Renders every field of the struct as a "name value" line,
+* fields that don't fit in the buffer are left out.
+*/
+static int __struct_read_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
+    __struct_t *st = (__struct_t *)private_data;
+    uproc_buf_t fbuf = *buf;
+    size_t i, off = 0, namelen;
+    int n, fdone;
+
+    *done = 1;
+    for (i = 0; i < st->nfields; ++i) {
+        const uproc_field_t *f = &st->fields[i];
+        namelen = strlen(f->name);
+        // room for "name " and at least one character and '\n'
+        if (off + namelen + 3 > buf->size)
+            break;
+        memcpy(buf->mem + off, f->name, namelen);
+        buf->mem[off + namelen] = ' ';
+
+        fbuf.mem = buf->mem + off + namelen + 1;
+        fbuf.size = buf->size - off - namelen - 1;
+        n = __type_ops[f->type].read_proc(&fbuf, &fdone, 0, st->base + f->offset);
+        if (n <= 0 || n >= fbuf.size)
+            break;
+        off += namelen + 1 + n;
+    }
+    return off;
+}
+
+static int __struct_check_fields(uproc_ctx_t *ctx, const char *name,
+                                 const uproc_field_t *fields, size_t nfields) {
+    size_t i;
+    for (i = 0; i < nfields; ++i) {
+        if (!fields[i].name || !*fields[i].name || !__is_primitive(fields[i].type)) {
+            if (ctx->dbg)
+                fprintf(stderr, "uproc: invalid field #%lu of struct \"%s\"\n", (unsigned long)i, name);
+            return -EINVAL;
+        }
+    }
+    return 0;
+}
+
+uproc_dentry_t* uproc_create_entry_struct(uproc_ctx_t *ctx,
+                                          const char *name, // name of the entry
+                                          mode_t mode,      // permissions
+                                          uproc_dentry_t* parent,
+                                          void *base,
+                                          const uproc_field_t *fields,
+                                          size_t nfields
+                                          ) {
+    uproc_dentry_t *ent;
+    __struct_t *st;
+    size_t size;
+
+    if (!ctx || __struct_check_fields(ctx, name, fields, nfields))
+        return NULL;
+
+    st = malloc(sizeof(*st) + nfields * sizeof(uproc_field_t));
+    if (!st) {
+        if (ctx->dbg)
+            fprintf(stderr, "uproc: memory shortage, can't allocate struct \"%s\"\n", name);
+        return NULL;
+    }
+    st->base = (char*)base;
+    st->nfields = nfields;
+    memcpy(st->fields, fields, nfields * sizeof(uproc_field_t));
+
+    // a line rarely needs more than 64 bytes
+    size = nfields * 64;
+    if (size < 4096)
+        size = 4096;
+    ent = uproc_entry_prepare(ctx, name, mode, size, parent,
+                              __struct_read_proc, /* write_proc */ NULL, (void*)st);
+    if (ent)
+        ent->free_proc = free;
+    if (!ent || uproc_entry_commit(ctx, ent)) {
+        free(st);
+        return NULL;
+    }
+    return ent;
+}
+
+uproc_dentry_t* uproc_mkdir_struct(uproc_ctx_t *ctx,
+                                   const char *name, // name of the directory
+                                   mode_t mode,      // permissions of the field entries
+                                   uproc_dentry_t* parent,
+                                   int readonly,
+                                   void *base,
+                                   const uproc_field_t *fields,
+                                   size_t nfields
+                                   ) {
+    uproc_dentry_t *dir;
+    size_t i;
+
+    if (!ctx || __struct_check_fields(ctx, name, fields, nfields))
+        return NULL;
+
+    dir = uproc_mkdir(ctx, name, parent);
+    if (!dir)
+        return NULL;
+
+    for (i = 0; i < nfields; ++i) {
+        const uproc_field_t *f = &fields[i];
+        if (!__uproc_utility_create_internal(ctx, f->name, mode, 0, dir, readonly,
+                                             __type_ops[f->type].read_proc,
+                                             __type_ops[f->type].write_proc,
+                                             (char*)base + f->offset, f->type)) {
+            if (ctx->dbg)
+                fprintf(stderr, "uproc: failed to create field \"%s\" of struct \"%s\"\n", f->name, name);
+        }
+    }
+    return dir;
+}
+
+/* appends @size bytes of @v in little-endian byte order */
+static void __put_le(char *dst, const void *v, size_t size) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    const char *src = (const char *)v;
+    size_t i;
+
+    for (i = 0; i < size; ++i)
+        dst[i] = src[size - 1 - i];
+#else
+    memcpy(dst, v, size);
+#endif
+}
+
+int uproc_render_entry_binary(uproc_dentry_t *entry, uproc_strbuf_t *out) {
+    uproc_seqlock_t *sl;
+    char raw[sizeof(long double)];
+    uint64_t v;
+    size_t size;
+    unsigned seq;
+
+    if (!entry || !out)
+        return -EINVAL;
+
+    if (entry->type == UPROC_TYPE_COUNTER) {
+        v = uproc_counter_read((uproc_counter_t *)entry->private_data);
+        size = sizeof(v);
+        memcpy(raw, &v, size);
+    } else if (__is_primitive(entry->type)) {
+        size = __type_ops[entry->type].size;
+        sl = uproc_entry_seqlock(entry);
+        if (sl) {
+            do {
+                seq = uproc_read_seqbegin(sl);
+                memcpy(raw, entry->private_data, size);
+            } while (uproc_read_seqretry(sl, seq));
+        } else {
+            memcpy(raw, entry->private_data, size);
+        }
+    } else {
+        return -ENOTSUP;
+    }
+
+    if (uproc_strbuf_reserve(out, UPROC_BINARY_HDR_SIZE + size))
+        return -ENOMEM;
+    out->data[out->len++] = (char)entry->type;
+    out->data[out->len++] = (char)size;
+    __put_le(out->data + out->len, raw, size);
+    out->len += size;
+    return 0;
+}
+
+static int __binary_render_proc(uproc_strbuf_t *out, void *private_data) {
+    return uproc_render_entry_binary((uproc_dentry_t *)private_data, out);
+}
+
+uproc_dentry_t* uproc_create_entry_binary(uproc_ctx_t *ctx,
+                                          const char *name, // name of the entry
+                                          mode_t mode,      // permissions
+                                          uproc_dentry_t* parent,
+                                          uproc_dentry_t *target
+                                          ) {
+    uproc_dentry_t *ent;
+
+    if (!target || S_ISDIR(target->mode))
+        return NULL;
+    ent = uproc_entry_prepare(ctx, name, mode & ~(S_IWUSR | S_IWGRP | S_IWOTH), 0, parent,
+                              NULL, NULL, (void*)target);
+    if (!ent)
+        return NULL;
+    ent->render_proc = __binary_render_proc;
+    // the binary view duplicates @target, leave it out of bulk reads
+    ent->flags |= UPROC_DENTRY_VIRTUAL;
+    return uproc_entry_commit(ctx, ent) ? NULL : ent;
+}
+
+/*
+* Batches of the apply files: every value is parsed into scratch space first,
+* so that a refused value leaves the entries untouched, then all of them are stored.
+*/
+static pthread_mutex_t __apply_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* a value of a batch, parsed into the scratch space at @off */
+typedef struct {
+    uproc_dentry_t *entry;
+    size_t          off, len;
+} __apply_value_t;
+
+/* state of one batch */
+typedef struct {
+    __apply_value_t *values;
+    size_t           n, cap;
+    uproc_strbuf_t   scratch;
+    uproc_strbuf_t   path;    // path of the current entry, relative to the root directory
+} __apply_t;
+
+/* state of an apply file */
+typedef struct {
+    uproc_ctx_t    *ctx;
+    uproc_dentry_t *dir;
+    uproc_strbuf_t  status;   // outcome of the last batch, guarded by __apply_lock
+} __apply_file_t;
+
+/* scratch space the write handler of @ent parses a value into, 0 if it can't be applied */
+static size_t __apply_size(uproc_dentry_t *ent) {
+    if (__is_primitive(ent->type) && ent->write_proc == __type_ops[ent->type].write_proc)
+        return __type_ops[ent->type].size;
+    if (ent->write_proc == __string_write_proc)
+        return ent->size;
+    return 0;
+}
+
+static int __apply_parse(__apply_t *a, uproc_dentry_t *ent, const char *value, size_t len) {
+    __apply_value_t *values;
+    uproc_buf_t b;
+    size_t size, off;
+    int n;
+
+    if (S_ISDIR(ent->mode))
+        return -EISDIR;
+    if (!ent->write_proc)
+        return -EACCES;
+    if (!(size = __apply_size(ent)))
+        return -EOPNOTSUPP;
+    // a group can't be written along with the program's writers unless they declared their lock
+    if (uproc_entry_seqlock(ent) && !uproc_entry_writer_lock(ent))
+        return -ENOLCK;
+
+    if (a->n == a->cap) {
+        a->cap = a->cap ? a->cap * 2 : 64;
+        values = realloc(a->values, a->cap * sizeof(*values));
+        if (!values)
+            return -ENOMEM;
+        a->values = values;
+    }
+    // slots are aligned for any of the primitive types
+    off = (a->scratch.len + 15) & ~(size_t)15;
+    if (uproc_strbuf_reserve(&a->scratch, off - a->scratch.len + size))
+        return -ENOMEM;
+
+    memset(&b, 0, sizeof(b));
+    b.mem = (char *)value;
+    b.size = len;
+    b.entry = ent;
+    n = ent->write_proc(&b, &b.done, 0, a->scratch.data + off);
+    if (n < 0)
+        return n;
+
+    a->scratch.len = off + size;
+    a->values[a->n].entry = ent;
+    a->values[a->n].off = off;
+    // a string is stored up to its terminating null
+    a->values[a->n++].len = ent->write_proc == __string_write_proc ? (size_t)n + 1 : size;
+    return 0;
+}
+
+static int __ptr_cmp(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t)*(void * const *)a, y = (uintptr_t)*(void * const *)b;
+
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/* sorts the @n pointers of @v and drops the duplicates, returns how many are left */
+static size_t __ptr_unique(void **v, size_t n) {
+    size_t i, m = 0;
+
+    qsort(v, n, sizeof(*v), __ptr_cmp);
+    for (i = 0; i < n; ++i) {
+        if (!m || v[i] != v[m - 1])
+            v[m++] = v[i];
+    }
+    return m;
+}
+
+static int __apply_store(__apply_t *a) {
+    void **seqs, **locks;
+    size_t i, nseqs = 0, nlocks = 0;
+
+    if (!a->n)
+        return 0;
+    seqs = malloc(2 * a->n * sizeof(*seqs));
+    if (!seqs)
+        return -ENOMEM;
+    locks = seqs + a->n;
+    // every seqlock here has a writer lock, see __apply_parse()
+    for (i = 0; i < a->n; ++i) {
+        if ((seqs[nseqs] = uproc_entry_seqlock(a->values[i].entry))) {
+            ++nseqs;
+            locks[nlocks++] = uproc_entry_writer_lock(a->values[i].entry);
+        }
+    }
+    nseqs = __ptr_unique(seqs, nseqs);
+    // in address order, a writer holding several of them takes them the same way
+    nlocks = __ptr_unique(locks, nlocks);
+
+    for (i = 0; i < nlocks; ++i)
+        pthread_mutex_lock((pthread_mutex_t *)locks[i]);
+    for (i = 0; i < nseqs; ++i)
+        uproc_write_seqbegin((uproc_seqlock_t *)seqs[i]);
+
+    for (i = 0; i < a->n; ++i)
+        memcpy(a->values[i].entry->private_data, a->scratch.data + a->values[i].off, a->values[i].len);
+
+    for (i = 0; i < nseqs; ++i)
+        uproc_write_seqend((uproc_seqlock_t *)seqs[i]);
+    for (i = nlocks; i > 0; --i)
+        pthread_mutex_unlock((pthread_mutex_t *)locks[i - 1]);
+
+    for (i = 0; i < a->n; ++i)
+        uproc_entry_invalidate(a->values[i].entry);
+    free(seqs);
+    return 0;
+}
+
+/* applies a batch with __apply_lock held */
+static int __uproc_apply(uproc_ctx_t *ctx, uproc_dentry_t *dir, const char *batch, size_t len,
+                         uproc_strbuf_t *status) {
+    const char *p = batch, *end = batch + len, *nl, *e, *q, *v;
+    uproc_dentry_t *ent;
+    char prefix[1024];
+    size_t line = 0;
+    __apply_t a;
+    int ret, plen;
+
+    if ((plen = uproc_entry_path(dir, prefix, sizeof(prefix))) < 0)
+        return plen;
+
+    memset(&a, 0, sizeof(a));
+    for (ret = 0; p < end && !ret; p = nl + 1) {
+        ++line;
+        nl = memchr(p, '\n', end - p);
+        if (!nl)
+            nl = end;
+        // trim whitespace, blank lines and comments are skipped
+        for (e = nl; e > p && isspace((unsigned char)e[-1]); --e)
+            ;
+        while (p < e && isspace((unsigned char)*p))
+            ++p;
+        if (p == e || *p == '#')
+            continue;
+        // the path ends at the first blank, the value is the rest of the line
+        for (q = p; q < e && !isspace((unsigned char)*q); ++q)
+            ;
+        for (v = q; v < e && isspace((unsigned char)*v); ++v)
+            ;
+
+        a.path.len = 0;
+        if ((plen && (uproc_strbuf_append(&a.path, prefix, plen) || uproc_strbuf_append(&a.path, "/", 1))) ||
+            uproc_strbuf_append(&a.path, p, q - p) || uproc_strbuf_append(&a.path, "", 1)) {
+            ret = -ENOMEM;
+        } else {
+            ent = uproc_lookup(ctx, a.path.data);
+            ret = ent ? __apply_parse(&a, ent, v, e - v) : -ENOENT;
+        }
+        if (ret && status)
+            uproc_strbuf_printf(status, "line %zu: %.*s: %s\n", line, (int)(q - p), p, strerror(-ret));
+    }
+
+    if (!ret)
+        ret = __apply_store(&a);
+    if (!ret && status)
+        uproc_strbuf_printf(status, "applied %zu\n", a.n);
+    if (ret && ctx->dbg)
+        fprintf(stderr, "uproc: batch refused at line %zu, reason: %s\n", line, strerror(-ret));
+
+    free(a.values);
+    uproc_strbuf_free(&a.scratch);
+    uproc_strbuf_free(&a.path);
+    return ret;
+}
+
+int uproc_apply(uproc_ctx_t *ctx, uproc_dentry_t *dir, const char *batch, size_t len,
+                uproc_strbuf_t *status) {
+    int ret;
+
+    if (!ctx || !dir || !S_ISDIR(dir->mode) || (!batch && len))
+        return -EINVAL;
+    pthread_mutex_lock(&__apply_lock);
+    ret = __uproc_apply(ctx, dir, batch, len, status);
+    pthread_mutex_unlock(&__apply_lock);
+    return ret;
+}
+
+static int __apply_write_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
+    __apply_file_t *af = (__apply_file_t *)private_data;
+    int ret;
+
+    *done = 1;
+    pthread_mutex_lock(&__apply_lock);
+    af->status.len = 0;
+    ret = __uproc_apply(af->ctx, af->dir, buf->mem, buf->size, &af->status);
+    pthread_mutex_unlock(&__apply_lock);
+    return ret ? ret : (int)buf->size;
+}
+
+static int __apply_render_proc(uproc_strbuf_t *out, void *private_data) {
+    __apply_file_t *af = (__apply_file_t *)private_data;
+    int ret;
+
+    pthread_mutex_lock(&__apply_lock);
+    ret = af->status.len ? uproc_strbuf_append(out, af->status.data, af->status.len) : 0;
+    pthread_mutex_unlock(&__apply_lock);
+    return ret;
+}
+
+static void __apply_free(void *private_data) {
+    __apply_file_t *af = (__apply_file_t *)private_data;
+
+    uproc_strbuf_free(&af->status);
+    free(af);
+}
+
+uproc_dentry_t* uproc_create_entry_apply(uproc_ctx_t *ctx,
+                                         const char *name, // name of the entry
+                                         uproc_dentry_t *dir
+                                         ) {
+    __apply_file_t *af;
+    uproc_dentry_t *ent;
+
+    if (!ctx)
+        return NULL;
+    if (!dir)
+        dir = ctx->root;
+    if (!S_ISDIR(dir->mode))
+        return NULL;
+    if (!name)
+        name = UPROC_APPLY_NAME;
+
+    af = calloc(1, sizeof(*af));
+    if (!af) {
+        if (ctx->dbg)
+            fprintf(stderr, "uproc: memory shortage, can't allocate apply state for \"%s\"\n", name);
+        return NULL;
+    }
+    af->ctx = ctx;
+    af->dir = dir;
+
+    // a batch is applied as a whole, once the handle is closed
+    ent = uproc_entry_prepare(ctx, name, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH, 0, dir,
+                              NULL, __apply_write_proc, (void*)af);
+    if (ent) {
+        ent->render_proc = __apply_render_proc;
+        ent->free_proc = __apply_free;
+        ent->flags |= UPROC_DENTRY_VIRTUAL | UPROC_DENTRY_ASSEMBLE;
+    }
+    if (!ent || uproc_entry_commit(ctx, ent)) {
+        free(af);
+        return NULL;
+    }
+    return ent;
+}
@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include <uproc.h>
+#include <shm.h>
 
 #include <pthread.h>
 
@@ -50,10 +51,1274 @@ void test_uproc_create_entries() {
     ASSERT_BOTH(ent4 == NULL, uproc_errno(), -ENOENT);
     subdir = uproc_mkdir(&uproc_ctx, "/dir/subdir", NULL);
     ASSERT(subdir);
+    // relative path with intermediate directories
+    ent4 = uproc_create_entry(&uproc_ctx, "dir/subdir/var4", 0, 4096, NULL, NULL, NULL, NULL);
+    ASSERT(ent4 && ent4->parent == subdir);
+    ASSERT_BOTH(uproc_create_entry(&uproc_ctx, "var1/var5", 0, 4096, NULL, NULL, NULL, NULL) == NULL,
+                uproc_errno(), -ENOTDIR);
 
     uproc_destroy(&uproc_ctx);
 }
 
+void test_uproc_parse() {
+    uint64_t u;
+    int64_t i;
+    double d;
+    float f;
+    const char *s;
+
+    s = "  12345\n";
+    ASSERT(uproc_parse_uint(s, strlen(s), UINT64_MAX, &u) == 0 && u == 12345);
+    s = "18446744073709551615";
+    ASSERT(uproc_parse_uint(s, strlen(s), UINT64_MAX, &u) == 0 && u == UINT64_MAX);
+    s = "18446744073709551616";
+    ASSERT(uproc_parse_uint(s, strlen(s), UINT64_MAX, &u) == -ERANGE);
+    s = "65536";
+    ASSERT(uproc_parse_uint(s, strlen(s), UINT16_MAX, &u) == -ERANGE);
+    s = "-1";
+    ASSERT(uproc_parse_uint(s, strlen(s), UINT64_MAX, &u) == -ERANGE);
+    s = "12a";
+    ASSERT(uproc_parse_uint(s, strlen(s), UINT64_MAX, &u) == -EINVAL);
+    s = " \n";
+    ASSERT(uproc_parse_uint(s, strlen(s), UINT64_MAX, &u) == -EINVAL);
+    // not null-terminated, only the first 3 bytes are looked at
+    ASSERT(uproc_parse_uint("1234", 3, UINT64_MAX, &u) == 0 && u == 123);
+
+    s = "-9223372036854775808";
+    ASSERT(uproc_parse_int(s, strlen(s), INT64_MIN, INT64_MAX, &i) == 0 && i == INT64_MIN);
+    s = "9223372036854775808";
+    ASSERT(uproc_parse_int(s, strlen(s), INT64_MIN, INT64_MAX, &i) == -ERANGE);
+    s = "-129";
+    ASSERT(uproc_parse_int(s, strlen(s), INT8_MIN, INT8_MAX, &i) == -ERANGE);
+    s = "+127 ";
+    ASSERT(uproc_parse_int(s, strlen(s), INT8_MIN, INT8_MAX, &i) == 0 && i == 127);
+
+    s = "1.5\n";
+    ASSERT(uproc_parse_double(s, strlen(s), &d) == 0 && d == 1.5);
+    s = "-0.1";
+    ASSERT(uproc_parse_double(s, strlen(s), &d) == 0 && d == -0.1);
+    s = "2.5e-3";
+    ASSERT(uproc_parse_double(s, strlen(s), &d) == 0 && d == 2.5e-3);
+    s = "123456789012345678901234567890";
+    ASSERT(uproc_parse_double(s, strlen(s), &d) == 0 && d == 123456789012345678901234567890.0);
+    s = "1e999";
+    ASSERT(uproc_parse_double(s, strlen(s), &d) == -ERANGE);
+    s = "1.5x";
+    ASSERT(uproc_parse_double(s, strlen(s), &d) == -EINVAL);
+    s = "1e39";
+    ASSERT(uproc_parse_float(s, strlen(s), &f) == -ERANGE);
+}
+
+#define COUNTER_THREADS 8
+#define COUNTER_INCS 100000
+uproc_counter_t global_counter;
+
+void* counter_thread(void *data) {
+    int i;
+    for (i = 0; i < COUNTER_INCS; ++i)
+        uproc_counter_inc(&global_counter);
+    return NULL;
+}
+
+void test_uproc_counter() {
+    int i, ret;
+    pthread_t tids[COUNTER_THREADS];
+    uproc_ctx_t uproc_ctx;
+    uproc_dentry_t *ent;
+    uproc_buf_t b;
+    char mem[64];
+    int done = 0;
+
+    uproc_counter_init(&global_counter);
+    for (i = 0; i < COUNTER_THREADS; ++i)
+        ASSERT(!pthread_create(&tids[i], NULL, counter_thread, NULL));
+    for (i = 0; i < COUNTER_THREADS; ++i)
+        pthread_join(tids[i], NULL);
+    uproc_counter_add(&global_counter, 5);
+    ASSERT(uproc_counter_read(&global_counter) == COUNTER_THREADS * COUNTER_INCS + 5);
+
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    ent = uproc_create_entry_counter(&uproc_ctx, "counter", 0, NULL, &global_counter);
+    ASSERT(ent && !ent->write_proc);
+
+    memset(&b, 0, sizeof(b));
+    b.mem = mem;
+    b.size = sizeof(mem);
+    b.entry = ent;
+    ret = ent->read_proc(&b, &done, 0, ent->private_data);
+    ASSERT(ret > 0 && done);
+    mem[ret] = '\0';
+    ASSERT(!strcmp(mem, "800005\n"));
+
+    uproc_destroy(&uproc_ctx);
+}
+
+void* hist_thread(void *data) {
+    uint64_t i;
+    ASSERT(!uproc_hist_thread_prepare((uproc_hist_t *)data));
+    for (i = 1; i <= COUNTER_INCS; ++i)
+        uproc_hist_record((uproc_hist_t *)data, i);
+    return NULL;
+}
+
+void test_uproc_hist() {
+    uproc_hist_t *h = uproc_hist_alloc();
+    uproc_hist_snapshot_t snap;
+    pthread_t tids[COUNTER_THREADS];
+    uint64_t i, p50, p99;
+
+    ASSERT(h);
+    uproc_hist_snapshot(h, &snap);
+    ASSERT(snap.count == 0 && uproc_hist_percentile(&snap, 0.5) == 0);
+
+    // recording never allocates, without a shard it goes to the overflow
+    for (i = 1; i <= 5000; ++i)
+        uproc_hist_record(h, i);
+    ASSERT(!h->shards[uproc_thread_slot()] && h->overflow.sum == 5000 * 5001 / 2);
+    ASSERT(!uproc_hist_thread_prepare(h) && h->shards[uproc_thread_slot()]);
+    for (; i <= 10000; ++i)
+        uproc_hist_record(h, i);
+    uproc_hist_record(h, UINT64_MAX);
+    uproc_hist_snapshot(h, &snap);
+    ASSERT(snap.count == 10001);
+    ASSERT(snap.min == 1 && snap.max == UINT64_MAX);
+    // relative error is bounded by 1 / UPROC_HIST_SUB_COUNT
+    p50 = uproc_hist_percentile(&snap, 0.5);
+    p99 = uproc_hist_percentile(&snap, 0.99);
+    ASSERT(p50 >= 5000 && p50 <= 5000 + 5000 / UPROC_HIST_SUB_COUNT);
+    ASSERT(p99 >= 9900 && p99 <= 9900 + 9900 / UPROC_HIST_SUB_COUNT);
+    ASSERT(uproc_hist_percentile(&snap, 1) == UINT64_MAX);
+    ASSERT(uproc_hist_percentile(&snap, 0) == 1);
+    // small values are exact
+    ASSERT(uproc_hist_bucket(7) == 7);
+    ASSERT(uproc_hist_bucket(UINT64_MAX) == UPROC_HIST_NBUCKETS - 1);
+
+    // every thread records into a shard of its own, merged by the snapshot
+    for (i = 0; i < COUNTER_THREADS; ++i)
+        ASSERT(!pthread_create(&tids[i], NULL, hist_thread, h));
+    for (i = 0; i < COUNTER_THREADS; ++i)
+        pthread_join(tids[i], NULL);
+    uproc_hist_snapshot(h, &snap);
+    ASSERT(snap.count == 10001 + COUNTER_THREADS * COUNTER_INCS);
+    ASSERT(snap.sum == 10000 * 10001 / 2 + UINT64_MAX +
+           (uint64_t)COUNTER_THREADS * COUNTER_INCS * (COUNTER_INCS + 1) / 2);
+    ASSERT(snap.min == 1 && snap.max == UINT64_MAX);
+    uproc_hist_free(h);
+}
+
+int read_entry(uproc_dentry_t *ent, char *mem, int size) {
+    uproc_buf_t b;
+    int done = 0, n;
+
+    memset(&b, 0, sizeof(b));
+    b.mem = mem;
+    b.size = size - 1;
+    b.entry = ent;
+    n = ent->read_proc(&b, &done, 0, ent->private_data);
+    if (n >= 0)
+        mem[n] = '\0';
+    return n;
+}
+
+void test_uproc_rate() {
+    int ret;
+    uproc_ctx_t uproc_ctx;
+    uproc_dentry_t *ent1, *ent2;
+    uint64_t v = 100;
+    uproc_counter_t *c = uproc_counter_alloc();
+    char mem[256];
+
+    ASSERT(c);
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    ent1 = uproc_create_entry_rate(&uproc_ctx, "rate", 0, NULL, 0, &v);
+    ent2 = uproc_create_entry_counter_rate(&uproc_ctx, "counter_rate", 0, NULL, 1000, c);
+    ASSERT(ent1 && ent2 && !ent1->write_proc && ent1->free_proc);
+
+    // first read only takes a sample
+    ASSERT(read_entry(ent1, mem, sizeof(mem)) > 0);
+    ASSERT(strstr(mem, "delta 0\n"));
+    v += 42;
+    usleep(20000);
+    ASSERT(read_entry(ent1, mem, sizeof(mem)) > 0);
+    ASSERT(strstr(mem, "delta 42\n"));
+    // a repeat read right after keeps the same base instead of resampling
+    ASSERT(read_entry(ent1, mem, sizeof(mem)) > 0);
+    ASSERT(strstr(mem, "delta 42\n"));
+    // delta is since the previous read
+    usleep(20000);
+    ASSERT(read_entry(ent1, mem, sizeof(mem)) > 0);
+    ASSERT(strstr(mem, "delta 0\n"));
+
+    // over a window, consecutive reads keep measuring from the same base
+    ASSERT(read_entry(ent2, mem, sizeof(mem)) > 0);
+    uproc_counter_add(c, 7);
+    ASSERT(read_entry(ent2, mem, sizeof(mem)) > 0);
+    ASSERT(strstr(mem, "delta 7\n"));
+    ASSERT(read_entry(ent2, mem, sizeof(mem)) > 0);
+    ASSERT(strstr(mem, "delta 7\n"));
+
+    uproc_destroy(&uproc_ctx);
+    free(c);
+}
+
+struct test_stats {
+    uint64_t bytes;
+    uint32_t packets;
+    int      errors;
+    double   load;
+};
+
+void test_uproc_struct() {
+    int ret;
+    uproc_ctx_t uproc_ctx;
+    uproc_dentry_t *ent, *dir, *field;
+    struct test_stats st = {1024, 8, -1, 0.5};
+    uproc_field_t fields[] = {
+        UPROC_FIELD(UPROC_TYPE_UINT64, struct test_stats, bytes),
+        UPROC_FIELD(UPROC_TYPE_UINT32, struct test_stats, packets),
+        UPROC_FIELD(UPROC_TYPE_INT, struct test_stats, errors),
+        UPROC_FIELD(UPROC_TYPE_DOUBLE, struct test_stats, load),
+    };
+    uproc_field_t bad_fields[] = {
+        {"bad", UPROC_TYPE_NONE, 0},
+    };
+    char mem[256];
+
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    ent = uproc_create_entry_struct(&uproc_ctx, "stats", 0, NULL, &st, fields, 4);
+    ASSERT(ent && !ent->write_proc);
+    ASSERT(read_entry(ent, mem, sizeof(mem)) > 0);
+    ASSERT(!strcmp(mem, "bytes 1024\npackets 8\nerrors -1\nload 0.500000\n"));
+    // fields that don't fit are left out
+    ASSERT(read_entry(ent, mem, 30) > 0);
+    ASSERT(!strcmp(mem, "bytes 1024\npackets 8\n"));
+    ASSERT(uproc_create_entry_struct(&uproc_ctx, "bad", 0, NULL, &st, bad_fields, 1) == NULL);
+
+    dir = uproc_mkdir_struct(&uproc_ctx, "stats_dir", 0, NULL, 0, &st, fields, 4);
+    ASSERT(dir && S_ISDIR(dir->mode));
+    field = uproc_create_entry(&uproc_ctx, "stats_dir/load", 0, 4096, NULL, NULL, NULL, NULL);
+    ASSERT_BOTH(field == NULL, uproc_errno(), -EEXIST);
+    st.packets = 9;
+    ASSERT(dir->children && read_entry(dir->children, mem, sizeof(mem)) > 0);
+    ASSERT(dir->children->type == UPROC_TYPE_DOUBLE);
+
+    uproc_destroy(&uproc_ctx);
+}
+
+struct test_stats global_stats;
+uproc_seqlock_t global_seqlock = UPROC_SEQLOCK_INIT;
+volatile int seqlock_stop;
+
+void* seqlock_writer(void *data) {
+    uint64_t i;
+    for (i = 0; !seqlock_stop; ++i) {
+        uproc_write_seqbegin(&global_seqlock);
+        global_stats.bytes = i;
+        global_stats.packets = i;
+        uproc_write_seqend(&global_seqlock);
+    }
+    return NULL;
+}
+
+void test_uproc_seqlock() {
+    int i, n, ret;
+    pthread_t tid;
+    uproc_ctx_t uproc_ctx;
+    uproc_dentry_t *dir, *ent;
+    unsigned long long bytes, packets;
+    uproc_field_t fields[] = {
+        UPROC_FIELD(UPROC_TYPE_UINT64, struct test_stats, bytes),
+        UPROC_FIELD(UPROC_TYPE_UINT32, struct test_stats, packets),
+    };
+    char mem[256];
+
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    // the seqlock of a directory guards the entries below it
+    dir = uproc_mkdir(&uproc_ctx, "net", NULL);
+    ASSERT(dir);
+    uproc_entry_set_seqlock(dir, &global_seqlock);
+    ent = uproc_create_entry_struct(&uproc_ctx, "stats", 0, dir, &global_stats, fields, 2);
+    ASSERT(ent);
+
+    seqlock_stop = 0;
+    ASSERT(!pthread_create(&tid, NULL, seqlock_writer, NULL));
+    for (i = 0; i < 100000; ++i) {
+        n = uproc_read_entry(ent, mem, sizeof(mem) - 1);
+        ASSERT(n > 0);
+        mem[n] = '\0';
+        ASSERT(sscanf(mem, "bytes %llu\npackets %llu", &bytes, &packets) == 2);
+        ASSERT(bytes == packets);
+    }
+    seqlock_stop = 1;
+    pthread_join(tid, NULL);
+
+    ASSERT(uproc_read_entry(dir, mem, sizeof(mem)) == -EISDIR);
+    uproc_destroy(&uproc_ctx);
+}
+
+uproc_dentry_t* find_child(uproc_dentry_t *dir, const char *name) {
+    uproc_dentry_t *p;
+
+    for (p = dir->children; p; p = p->next) {
+        if (!strcmp(p->name, name))
+            return p;
+    }
+    return NULL;
+}
+
+void test_uproc_bulk() {
+    uproc_ctx_t uproc_ctx;
+    uproc_strbuf_t out;
+    uproc_dentry_t *net, *eth0, *ent;
+    int ret, mtu = 1500;
+    uint64_t rx = 7;
+    uproc_field_t fields[] = {
+        UPROC_FIELD(UPROC_TYPE_UINT64, struct test_stats, bytes),
+        UPROC_FIELD(UPROC_TYPE_UINT32, struct test_stats, packets),
+    };
+    char mem[16];
+
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    ASSERT(!uproc_enable_bulk(&uproc_ctx, UPROC_BULK_TEXT | UPROC_BULK_JSON));
+    // every directory gets its own bulk files
+    net = uproc_mkdir(&uproc_ctx, "net", NULL);
+    ASSERT(net);
+    ASSERT(uproc_create_entry_int(&uproc_ctx, "mtu", 0, net, 0, &mtu));
+    eth0 = uproc_mkdir(&uproc_ctx, "eth0", net);
+    ASSERT(eth0);
+    ASSERT(uproc_create_entry_uint64(&uproc_ctx, "rx", 0, eth0, 1, &rx));
+    global_stats.bytes = 3;
+    global_stats.packets = 3;
+    ASSERT(uproc_create_entry_struct(&uproc_ctx, "stats", 0, eth0, &global_stats, fields, 2));
+    ASSERT(uproc_create_entry_cstring(&uproc_ctx, "name", 0, NULL, 64, "say \"hi\""));
+    // entries without a read handler are left out
+    ASSERT(uproc_create_entry(&uproc_ctx, "wo", S_IWUSR, 64, NULL, NULL, NULL, NULL));
+
+    memset(&out, 0, sizeof(out));
+    ASSERT((ent = find_child(uproc_ctx.root, ".all")));
+    ASSERT(!uproc_render_entry(ent, &out));
+    ASSERT(out.len == strlen("name say \"hi\"\n"
+                             "net/eth0/stats bytes 3\n"
+                             "net/eth0/stats packets 3\n"
+                             "net/eth0/rx 7\n"
+                             "net/mtu 1500\n"));
+    ASSERT(!memcmp(out.data, "name say \"hi\"\n"
+                             "net/eth0/stats bytes 3\n"
+                             "net/eth0/stats packets 3\n"
+                             "net/eth0/rx 7\n"
+                             "net/mtu 1500\n", out.len));
+
+    out.len = 0;
+    ASSERT((ent = find_child(net, ".all")));
+    ASSERT(!uproc_render_entry(ent, &out));
+    ASSERT(out.len == strlen("eth0/stats bytes 3\neth0/stats packets 3\neth0/rx 7\nmtu 1500\n"));
+    ASSERT(!memcmp(out.data, "eth0/stats bytes 3\neth0/stats packets 3\neth0/rx 7\nmtu 1500\n", out.len));
+
+    out.len = 0;
+    ASSERT((ent = find_child(eth0, ".all.json")));
+    ASSERT(!uproc_render_entry(ent, &out));
+    ASSERT(out.len == strlen("{\n\"stats\": \"bytes 3\\npackets 3\",\n\"rx\": \"7\"\n}\n"));
+    ASSERT(!memcmp(out.data, "{\n\"stats\": \"bytes 3\\npackets 3\",\n\"rx\": \"7\"\n}\n", out.len));
+
+    out.len = 0;
+    ASSERT((ent = find_child(uproc_ctx.root, ".all.json")));
+    ASSERT(!uproc_render_entry(ent, &out));
+    ASSERT(out.len > 20 && !memcmp(out.data, "{\n\"name\": \"say \\\"hi\\\"\",\n", 20));
+    uproc_strbuf_free(&out);
+
+    // reads from within the program are cut at the size asked for
+    ASSERT((ent = find_child(net, ".all")));
+    ASSERT(uproc_read_entry(ent, mem, sizeof(mem)) == sizeof(mem));
+    ASSERT(!memcmp(mem, "eth0/stats bytes", sizeof(mem)));
+
+    uproc_destroy(&uproc_ctx);
+}
+
+void test_uproc_query() {
+    uproc_ctx_t uproc_ctx;
+    uproc_strbuf_t out;
+    uproc_dentry_t *net;
+    int ret, mtu = 1500;
+    uint64_t rx = 7;
+    const char *q = "net/mtu\n\n  /net/eth0/rx \r\nnet/nope\nnet\n.query\nnet/mtu";
+    const char *a = "net/mtu 1500\n"
+                    "/net/eth0/rx 7\n"
+                    "net/nope !No such file or directory\n"
+                    "net !Is a directory\n"
+                    ".query !Function not implemented\n"
+                    "net/mtu 1500\n";
+
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    ASSERT(!uproc_enable_query(&uproc_ctx));
+    net = uproc_mkdir(&uproc_ctx, "net", NULL);
+    ASSERT(net);
+    ASSERT(uproc_create_entry_int(&uproc_ctx, "mtu", 0, net, 0, &mtu));
+    ASSERT(uproc_mkdir(&uproc_ctx, "net/eth0", NULL));
+    ASSERT(uproc_create_entry_uint64(&uproc_ctx, "net/eth0/rx", 0, NULL, 1, &rx));
+    ASSERT(uproc_lookup(&uproc_ctx, "net/eth0/rx") == uproc_lookup(&uproc_ctx, "/net/eth0/rx"));
+
+    memset(&out, 0, sizeof(out));
+    ASSERT(!uproc_query(&uproc_ctx, q, strlen(q), &out));
+    ASSERT(out.len == strlen(a) && !memcmp(out.data, a, out.len));
+    uproc_strbuf_free(&out);
+
+    uproc_destroy(&uproc_ctx);
+}
+
+void test_uproc_binary() {
+    uproc_ctx_t uproc_ctx;
+    uproc_strbuf_t out;
+    uproc_dentry_t *net, *ent, *bin;
+    uproc_counter_t *c;
+    int ret, mtu = -2;
+    uint16_t port = 0x1234;
+    double load = 0.5;
+    char mem[64];
+    const unsigned char rec_mtu[] = { UPROC_TYPE_INT, 4, 0xfe, 0xff, 0xff, 0xff };
+    const unsigned char rec_c[] = { UPROC_TYPE_COUNTER, 8, 3, 0, 0, 0, 0, 0, 0, 0 };
+    const unsigned char all[] = {
+        4, 0, 'p', 'o', 'r', 't', UPROC_TYPE_UINT16, 2, 0x34, 0x12,
+        3, 0, 'm', 't', 'u', UPROC_TYPE_INT, 4, 0xfe, 0xff, 0xff, 0xff,
+    };
+
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    ASSERT(!uproc_enable_bulk(&uproc_ctx, UPROC_BULK_BINARY));
+    net = uproc_mkdir(&uproc_ctx, "net", NULL);
+    ASSERT(net);
+    ent = uproc_create_entry_int(&uproc_ctx, "mtu", 0, net, 0, &mtu);
+    ASSERT(ent);
+    ASSERT(uproc_create_entry_uint16(&uproc_ctx, "port", 0, net, 0, &port));
+    // entries without a binary form are left out of the subtree
+    ASSERT(uproc_create_entry_cstring(&uproc_ctx, "name", 0, net, 64, "eth0"));
+    bin = uproc_create_entry_binary(&uproc_ctx, "mtu.bin", 0, net, ent);
+    ASSERT(bin);
+    ASSERT(!uproc_create_entry_binary(&uproc_ctx, "net.bin", 0, NULL, net));
+
+    ASSERT(uproc_read_entry(bin, mem, sizeof(mem)) == sizeof(rec_mtu));
+    ASSERT(!memcmp(mem, rec_mtu, sizeof(rec_mtu)));
+
+    c = uproc_counter_alloc();
+    ASSERT(c);
+    uproc_counter_add(c, 3);
+    ent = uproc_create_entry_counter(&uproc_ctx, "c", 0, NULL, c);
+    ASSERT(ent);
+    memset(&out, 0, sizeof(out));
+    ASSERT(!uproc_render_entry_binary(ent, &out));
+    ASSERT(out.len == sizeof(rec_c) && !memcmp(out.data, rec_c, sizeof(rec_c)));
+
+    out.len = 0;
+    ent = uproc_create_entry_double(&uproc_ctx, "load", 0, NULL, 0, &load);
+    ASSERT(ent);
+    ASSERT(!uproc_render_entry_binary(ent, &out));
+    ASSERT(out.len == 2 + sizeof(double) && out.data[0] == UPROC_TYPE_DOUBLE);
+    ASSERT(!memcmp(out.data + 2, &load, sizeof(double)));
+    ASSERT(uproc_render_entry_binary(find_child(net, "name"), &out) == -ENOTSUP);
+
+    out.len = 0;
+    ASSERT((ent = find_child(net, ".all.bin")));
+    ASSERT(!uproc_render_entry(ent, &out));
+    ASSERT(out.len == sizeof(all) && !memcmp(out.data, all, sizeof(all)));
+    uproc_strbuf_free(&out);
+
+    uproc_destroy(&uproc_ctx);
+    free(c);
+}
+
+void test_uproc_shm() {
+    uproc_ctx_t uproc_ctx;
+    uproc_shm_reader_t r;
+    const uproc_shm_dirent_t *d;
+    uproc_shm_slot_t *slot;
+    uproc_dentry_t *net, *ent;
+    int ret, mtu = 1500, x;
+    uint64_t rx = 7, y;
+    char name[64];
+
+    snprintf(name, sizeof(name), "/uproc_test.%d", (int)getpid());
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    net = uproc_mkdir(&uproc_ctx, "net", NULL);
+    ASSERT(net);
+    ASSERT(uproc_create_entry_int(&uproc_ctx, "mtu", 0, net, 0, &mtu));
+    ASSERT(uproc_create_entry_cstring(&uproc_ctx, "name", 0, net, 64, "eth0"));
+    // a live object of the same name is left alone
+    ret = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    ASSERT(ret >= 0);
+    close(ret);
+    ASSERT(uproc_shm_open(&uproc_ctx, name, 2) == -EEXIST);
+    ASSERT(!shm_unlink(name));
+    ASSERT(!uproc_shm_open(&uproc_ctx, name, 2));
+    ASSERT(uproc_shm_sync(&uproc_ctx) == 1);
+
+    ASSERT(!uproc_shm_attach(&r, name));
+    ASSERT(uproc_shm_count(&r) == 1);
+    d = uproc_shm_find(&r, "net/mtu");
+    ASSERT(d && d->type == UPROC_TYPE_INT && d->size == sizeof(int));
+    ASSERT(uproc_shm_read(&r, d, &x, sizeof(x)) == sizeof(int) && x == 1500);
+    ASSERT(!uproc_shm_find(&r, "net/name"));
+
+    // entries registered later are exported by the next sync
+    ent = uproc_create_entry_uint64(&uproc_ctx, "rx", 0, net, 1, &rx);
+    ASSERT(ent);
+    mtu = 9000;
+    ASSERT(uproc_shm_sync(&uproc_ctx) == 2);
+    ASSERT(uproc_shm_read(&r, d, &x, sizeof(x)) == sizeof(int) && x == 9000);
+    d = uproc_shm_find(&r, "net/rx");
+    ASSERT(d && uproc_shm_read(&r, d, &y, sizeof(y)) == sizeof(y) && y == 7);
+    ASSERT(uproc_shm_read(&r, d, &x, sizeof(x)) == -ENOSPC);
+    rx = 8;
+    uproc_shm_update(&uproc_ctx, ent);
+    ASSERT(uproc_shm_read(&r, d, &y, sizeof(y)) == sizeof(y) && y == 8);
+
+    // a slot handed over to the program is written in place, syncs leave it alone
+    slot = uproc_shm_slot(&uproc_ctx, ent);
+    ASSERT(slot && ent->flags & UPROC_DENTRY_SHM_OWNED);
+    ASSERT(((uintptr_t)slot & (UPROC_SHM_SLOT_ALIGN - 1)) == 0);
+    ASSERT(uproc_shm_slot_write(slot, name, 17) == -EINVAL);
+    y = 42;
+    ASSERT(!uproc_shm_slot_write(slot, &y, sizeof(y)));
+    ASSERT(uproc_shm_read(&r, d, &y, sizeof(y)) == sizeof(y) && y == 42);
+    rx = 9;
+    uproc_shm_update(&uproc_ctx, ent);
+    ASSERT(uproc_shm_sync(&uproc_ctx) == 2);
+    ASSERT(uproc_shm_read(&r, d, &y, sizeof(y)) == sizeof(y) && y == 42);
+    ASSERT(!uproc_shm_slot(&uproc_ctx, net));
+
+    // no room left
+    ASSERT(uproc_create_entry_int(&uproc_ctx, "mtu2", 0, net, 0, &mtu));
+    ASSERT(uproc_shm_sync(&uproc_ctx) == 2);
+
+    // the object is gone with the context, mappings of readers stay valid
+    uproc_destroy(&uproc_ctx);
+    ASSERT(uproc_shm_count(&r) == 2);
+    uproc_shm_detach(&r);
+    ASSERT(uproc_shm_attach(&r, name) == -ENOENT);
+    uproc_shm_detach(&r);
+}
+
+void test_uproc_metrics() {
+    uproc_ctx_t uproc_ctx;
+    uproc_strbuf_t out;
+    uproc_dentry_t *net, *ent;
+    uproc_counter_t *c;
+    uproc_hist_t *h;
+    int ret, mtu = -2;
+    double load = 0.5;
+    const char *expected =
+        "# TYPE app_lat summary\n"
+        "app_lat{quantile=\"0.5\"} 10\n"
+        "app_lat{quantile=\"0.9\"} 10\n"
+        "app_lat{quantile=\"0.99\"} 10\n"
+        "app_lat{quantile=\"0.999\"} 10\n"
+        "app_lat_sum 20\n"
+        "app_lat_count 2\n"
+        "# TYPE app_rx counter\n"
+        "app_rx_total 3\n"
+        "# TYPE app_net_eth_0_load gauge\n"
+        "app_net_eth_0_load 0.5\n"
+        "# TYPE app_net_mtu gauge\n"
+        "app_net_mtu -2\n"
+        "# EOF\n";
+
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    ASSERT(!uproc_enable_metrics(&uproc_ctx, "app"));
+    ASSERT(uproc_enable_metrics(&uproc_ctx, "app") == -EEXIST);
+    net = uproc_mkdir(&uproc_ctx, "net", NULL);
+    ASSERT(net);
+    ASSERT(uproc_create_entry_int(&uproc_ctx, "mtu", 0, net, 0, &mtu));
+    ASSERT(uproc_mkdir(&uproc_ctx, "eth-0", net));
+    ASSERT(uproc_create_entry_double(&uproc_ctx, "net/eth-0/load", 0, NULL, 0, &load));
+    ASSERT(uproc_create_entry_cstring(&uproc_ctx, "name", 0, net, 64, "eth0"));
+    c = uproc_counter_alloc();
+    ASSERT(c);
+    uproc_counter_add(c, 3);
+    ASSERT(uproc_create_entry_counter(&uproc_ctx, "rx", 0, NULL, c));
+    h = uproc_hist_alloc();
+    ASSERT(h);
+    uproc_hist_record(h, 10);
+    uproc_hist_record(h, 10);
+    ASSERT(uproc_create_entry_hist(&uproc_ctx, "lat", 0, NULL, h));
+
+    ent = find_child(uproc_ctx.root, UPROC_METRICS_NAME);
+    ASSERT(ent);
+    memset(&out, 0, sizeof(out));
+    ASSERT(!uproc_render_entry(ent, &out));
+    ASSERT(out.len == strlen(expected) && !memcmp(out.data, expected, out.len));
+
+    // names are cached, values are formatted again
+    mtu = 1500;
+    out.len = 0;
+    ASSERT(!uproc_render_entry(ent, &out));
+    ASSERT(out.len == strlen(expected) + 2);
+
+    // a path sanitized to a name already in use gets a suffix
+    ASSERT(uproc_create_entry_int(&uproc_ctx, "net-mtu", 0, NULL, 0, &mtu));
+    out.len = 0;
+    ASSERT(!uproc_render_entry(ent, &out));
+    ASSERT(!uproc_strbuf_append(&out, "", 1));
+    ASSERT(strstr(out.data, "# TYPE app_net_mtu_2 gauge\napp_net_mtu_2 1500\n"));
+    ASSERT(strstr(out.data, "# TYPE app_net_mtu gauge\napp_net_mtu 1500\n"));
+    uproc_strbuf_free(&out);
+
+    uproc_destroy(&uproc_ctx);
+    free(c);
+    uproc_hist_free(h);
+}
+
+static int expensive_calls;
+static int expensive_read_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
+    int n = snprintf(buf->mem, buf->size, "calls %d\n", ++expensive_calls);
+    *done = 1;
+    return n >= buf->size ? buf->size : n;
+}
+
+static int fixed_read_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
+    *done = 1;
+    return snprintf(buf->mem, buf->size, "fixed\n");
+}
+
+static int toggle_stop;
+static void* toggle_reader(void *data) {
+    char mem[64];
+
+    while (!__atomic_load_n(&toggle_stop, __ATOMIC_RELAXED)) {
+        ASSERT(uproc_read_entry((uproc_dentry_t *)data, mem, sizeof(mem)) == 6);
+        ASSERT(!memcmp(mem, "fixed\n", 6));
+    }
+    return NULL;
+}
+
+void test_uproc_cache() {
+    uproc_ctx_t uproc_ctx;
+    uproc_dentry_t *ent;
+    pthread_t tids[4];
+    char mem[64];
+    int ret, i;
+
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    ent = uproc_create_entry(&uproc_ctx, "walk", 0, 4096, NULL, expensive_read_proc, NULL, NULL);
+    ASSERT(ent);
+    ASSERT(!uproc_entry_set_cache_ttl(ent, 200));
+    ASSERT(uproc_entry_set_cache_ttl(uproc_ctx.root, 200) == -EINVAL);
+
+    expensive_calls = 0;
+    for (i = 0; i < 10; ++i) {
+        ASSERT(uproc_read_entry(ent, mem, sizeof(mem)) == strlen("calls 1\n"));
+        ASSERT(!memcmp(mem, "calls 1\n", strlen("calls 1\n")));
+    }
+    ASSERT(expensive_calls == 1);
+
+    uproc_entry_invalidate(ent);
+    ASSERT(uproc_read_entry(ent, mem, sizeof(mem)) > 0);
+    ASSERT(uproc_read_entry(ent, mem, sizeof(mem)) > 0);
+    ASSERT(expensive_calls == 2);
+
+    usleep(250 * 1000);
+    ASSERT(uproc_read_entry(ent, mem, sizeof(mem)) > 0);
+    ASSERT(!memcmp(mem, "calls 3\n", strlen("calls 3\n")));
+
+    // without the cache every read calls the handler
+    ASSERT(!uproc_entry_set_cache_ttl(ent, 0));
+    ASSERT(uproc_read_entry(ent, mem, sizeof(mem)) > 0);
+    ASSERT(uproc_read_entry(ent, mem, sizeof(mem)) > 0);
+    ASSERT(expensive_calls == 5);
+    // it stays with the entry, readers may still be using it
+    ASSERT(ent->cache);
+
+    // turning the cache on and off while it is read
+    ent = uproc_create_entry(&uproc_ctx, "toggled", 0, 4096, NULL, fixed_read_proc, NULL, NULL);
+    ASSERT(ent);
+    toggle_stop = 0;
+    for (i = 0; i < 4; ++i)
+        ASSERT(!pthread_create(&tids[i], NULL, toggle_reader, ent));
+    for (i = 0; i < 2000; ++i)
+        ASSERT(!uproc_entry_set_cache_ttl(ent, i & 1));
+    __atomic_store_n(&toggle_stop, 1, __ATOMIC_RELAXED);
+    for (i = 0; i < 4; ++i)
+        pthread_join(tids[i], NULL);
+
+    uproc_destroy(&uproc_ctx);
+}
+
+static int slow_calls;
+static int slow_read_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
+    int n;
+
+    __atomic_add_fetch(&slow_calls, 1, __ATOMIC_RELAXED);
+    usleep(200 * 1000);
+    n = snprintf(buf->mem, buf->size, "slow\n");
+    *done = 1;
+    return n;
+}
+
+static pthread_barrier_t herd_barrier;
+static void* herd_reader(void *data) {
+    char mem[64];
+
+    pthread_barrier_wait(&herd_barrier);
+    ASSERT(uproc_read_entry((uproc_dentry_t *)data, mem, sizeof(mem)) == 5);
+    ASSERT(!memcmp(mem, "slow\n", 5));
+    return NULL;
+}
+
+void test_uproc_single_flight() {
+    uproc_ctx_t uproc_ctx;
+    uproc_dentry_t *ent;
+    pthread_t tids[8];
+    char mem[64];
+    int ret, i;
+
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    ent = uproc_create_entry(&uproc_ctx, "slow", 0, 4096, NULL, slow_read_proc, NULL, NULL);
+    ASSERT(ent);
+    ASSERT(!uproc_entry_set_single_flight(ent));
+
+    // a herd of readers costs one call of the handler
+    slow_calls = 0;
+    pthread_barrier_init(&herd_barrier, NULL, 8);
+    for (i = 0; i < 8; ++i)
+        ASSERT(!pthread_create(&tids[i], NULL, herd_reader, ent));
+    for (i = 0; i < 8; ++i)
+        pthread_join(tids[i], NULL);
+    pthread_barrier_destroy(&herd_barrier);
+    ASSERT(slow_calls == 1);
+
+    // without a TTL, a later read renders again
+    ASSERT(uproc_read_entry(ent, mem, sizeof(mem)) == 5);
+    ASSERT(slow_calls == 2);
+    // disabling the TTL keeps the entry single-flight
+    ASSERT(!uproc_entry_set_cache_ttl(ent, 0));
+    ASSERT(ent->cache);
+
+    uproc_destroy(&uproc_ctx);
+}
+
+static int publish_stop;
+static void* publish_reader(void *data) {
+    char mem[256];
+    int n, i, reads = 0;
+
+    while (!__atomic_load_n(&publish_stop, __ATOMIC_RELAXED) || !reads) {
+        // every publication is a run of one letter telling its length
+        n = uproc_read_entry((uproc_dentry_t *)data, mem, sizeof(mem));
+        ASSERT(n > 0);
+        for (i = 0; i < n; ++i)
+            ASSERT(mem[i] == 'a' + n % 26);
+        ++reads;
+    }
+    return NULL;
+}
+
+void test_uproc_publish() {
+    uproc_ctx_t uproc_ctx;
+    uproc_dentry_t *ent, *dir;
+    uproc_strbuf_t out;
+    pthread_t tids[4];
+    char mem[256];
+    int ret, i, n;
+
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    dir = uproc_mkdir(&uproc_ctx, "net", NULL);
+    ASSERT(dir);
+    ent = uproc_create_entry_publish(&uproc_ctx, "rx", 0, dir);
+    ASSERT(ent);
+    ASSERT(uproc_read_entry(ent, mem, sizeof(mem)) == 0);
+    ASSERT(uproc_publish(dir, "1\n", 2) == -EINVAL);
+
+    ASSERT(!uproc_publish(ent, "42\n", 3));
+    ASSERT(uproc_read_entry(ent, mem, sizeof(mem)) == 3);
+    ASSERT(!memcmp(mem, "42\n", 3));
+
+    // published values take part in bulk files like any other entry
+    ASSERT(uproc_create_entry_bulk(&uproc_ctx, NULL, NULL, UPROC_BULK_TEXT));
+    memset(&out, 0, sizeof(out));
+    ASSERT(!uproc_render_entry(find_child(uproc_ctx.root, UPROC_BULK_TEXT_NAME), &out));
+    ASSERT(out.len == strlen("net/rx 42\n") && !memcmp(out.data, "net/rx 42\n", out.len));
+    uproc_strbuf_free(&out);
+
+    // readers only ever see whole publications
+    memset(mem, 0, sizeof(mem));
+    ASSERT(!uproc_publish(ent, "b", 1));
+    publish_stop = 0;
+    for (i = 0; i < 4; ++i)
+        ASSERT(!pthread_create(&tids[i], NULL, publish_reader, ent));
+    for (i = 0; i < 20000; ++i) {
+        n = 1 + i % 200;
+        memset(mem, 'a' + n % 26, n);
+        ASSERT(!uproc_publish(ent, mem, n));
+    }
+    __atomic_store_n(&publish_stop, 1, __ATOMIC_RELAXED);
+    for (i = 0; i < 4; ++i)
+        pthread_join(tids[i], NULL);
+
+    uproc_destroy(&uproc_ctx);
+}
+
+static int64_t tracked;
+static int tracked_stop;
+static void* tracked_reader(void *data) {
+    char mem[64];
+    long long last = 0, v;
+    int n;
+
+    while (!__atomic_load_n(&tracked_stop, __ATOMIC_RELAXED)) {
+        n = uproc_read_entry((uproc_dentry_t *)data, mem, sizeof(mem) - 1);
+        ASSERT(n > 0 && mem[n - 1] == '\n');
+        mem[n] = '\0';
+        // the text always matches one value, never an older one than seen before
+        v = strtoll(mem, NULL, 10);
+        ASSERT(v >= last);
+        last = v;
+    }
+    return NULL;
+}
+
+void test_uproc_fmt_cache() {
+    uproc_ctx_t uproc_ctx;
+    uproc_dentry_t *i, *d, *t;
+    pthread_t tids[4];
+    double ratio = 0.5;
+    int v = 5, ret, k;
+    char mem[64];
+
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    i = uproc_create_entry_int(&uproc_ctx, "v", 0, NULL, 0, &v);
+    d = uproc_create_entry_double(&uproc_ctx, "ratio", 0, NULL, 1, &ratio);
+    t = uproc_create_entry_int64(&uproc_ctx, "tracked", 0, NULL, 1, &tracked);
+    ASSERT(i && d && t);
+
+    for (k = 0; k < 3; ++k) {
+        ASSERT(uproc_read_entry(i, mem, sizeof(mem)) == 2);
+        ASSERT(!memcmp(mem, "5\n", 2));
+    }
+    v = -12;
+    ASSERT(uproc_read_entry(i, mem, sizeof(mem)) == 4);
+    ASSERT(!memcmp(mem, "-12\n", 4));
+    v = 5;
+    ASSERT(uproc_read_entry(i, mem, sizeof(mem)) == 2);
+    ASSERT(!memcmp(mem, "5\n", 2));
+
+    ASSERT(uproc_read_entry(d, mem, sizeof(mem)) == strlen("0.500000\n"));
+    ratio = 1e30;
+    ASSERT(uproc_read_entry(d, mem, sizeof(mem)) == strlen("1000000000000000019884624838656.000000\n"));
+    ratio = 0.25;
+    ASSERT(uproc_read_entry(d, mem, sizeof(mem)) == strlen("0.250000\n"));
+    ASSERT(!memcmp(mem, "0.250000\n", strlen("0.250000\n")));
+
+    tracked_stop = 0;
+    for (k = 0; k < 4; ++k)
+        ASSERT(!pthread_create(&tids[k], NULL, tracked_reader, t));
+    for (k = 0; k < 100000; ++k)
+        __atomic_store_n(&tracked, tracked + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&tracked_stop, 1, __ATOMIC_RELAXED);
+    for (k = 0; k < 4; ++k)
+        pthread_join(tids[k], NULL);
+
+    uproc_destroy(&uproc_ctx);
+}
+
+/* a thread owning some state, answering the requests handed over to it */
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  posted;
+    uproc_token_t  *token;
+    int             stop;
+    int             busy;   // fails the requests
+    int             depth;
+} owner = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+static int owner_async_proc(uproc_token_t *token, const char *in, size_t len, void *private_data) {
+    if (private_data)
+        return -EAGAIN;
+    pthread_mutex_lock(&owner.lock);
+    owner.token = token;
+    pthread_cond_signal(&owner.posted);
+    pthread_mutex_unlock(&owner.lock);
+    return UPROC_PENDING;
+}
+
+/* an owner which sits on the tokens */
+static uproc_token_t *ignored_token;
+static int ignoring_async_proc(uproc_token_t *token, const char *in, size_t len, void *private_data) {
+    ignored_token = token;
+    return UPROC_PENDING;
+}
+
+static void* owner_thread(void *data) {
+    uproc_token_t *token;
+    char mem[32];
+    int n;
+
+    pthread_mutex_lock(&owner.lock);
+    while (!owner.stop) {
+        if (!(token = owner.token)) {
+            pthread_cond_wait(&owner.posted, &owner.lock);
+            continue;
+        }
+        owner.token = NULL;
+        if (owner.busy) {
+            uproc_complete_error(token, -EBUSY);
+        } else {
+            n = snprintf(mem, sizeof(mem), "queue %d\n", owner.depth++);
+            ASSERT(!uproc_complete(token, mem, n));
+        }
+    }
+    pthread_mutex_unlock(&owner.lock);
+    return NULL;
+}
+
+void test_uproc_async() {
+    uproc_ctx_t uproc_ctx;
+    uproc_dentry_t *ent, *refused, *ignored;
+    uproc_strbuf_t out;
+    pthread_t tid;
+    char mem[64];
+    uint64_t start;
+    int ret;
+
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    ent = uproc_create_entry_async(&uproc_ctx, "queue", 0, NULL, owner_async_proc, NULL);
+    refused = uproc_create_entry_async(&uproc_ctx, "refused", 0, NULL, owner_async_proc, (void*)1);
+    ASSERT(ent && refused);
+    ASSERT(!uproc_create_entry_async(&uproc_ctx, "none", 0, NULL, NULL, NULL));
+    ASSERT(!pthread_create(&tid, NULL, owner_thread, NULL));
+
+    ASSERT(uproc_read_entry(ent, mem, sizeof(mem)) == strlen("queue 0\n"));
+    ASSERT(!memcmp(mem, "queue 0\n", strlen("queue 0\n")));
+    memset(&out, 0, sizeof(out));
+    ASSERT(!uproc_render_entry(ent, &out));
+    ASSERT(out.len == strlen("queue 1\n") && !memcmp(out.data, "queue 1\n", out.len));
+    uproc_strbuf_free(&out);
+
+    pthread_mutex_lock(&owner.lock);
+    owner.busy = 1;
+    pthread_mutex_unlock(&owner.lock);
+    ASSERT(uproc_read_entry(ent, mem, sizeof(mem)) == -EBUSY);
+    ASSERT(uproc_read_entry(refused, mem, sizeof(mem)) == -EAGAIN);
+
+    // a request left unanswered gives up after the budget, the owner may still answer late
+    ignored = uproc_create_entry_async(&uproc_ctx, "ignored", 0, NULL, ignoring_async_proc, NULL);
+    ASSERT(ignored && !uproc_entry_set_budget(ignored, 20, UPROC_BUDGET_EAGAIN));
+    start = __uproc_now_ns();
+    ASSERT(uproc_read_entry(ignored, mem, sizeof(mem)) == -ETIMEDOUT);
+    ASSERT(__uproc_now_ns() - start >= 20000000ULL && ignored_token);
+    ASSERT(uproc_entry_slow_calls(ignored) == 1);
+    ASSERT(!uproc_complete(ignored_token, "late\n", 5));
+
+    pthread_mutex_lock(&owner.lock);
+    owner.stop = 1;
+    pthread_cond_signal(&owner.posted);
+    pthread_mutex_unlock(&owner.lock);
+    pthread_join(tid, NULL);
+    uproc_destroy(&uproc_ctx);
+}
+
+static int sleepy_us, sleepy_hold;
+static int sleepy_read_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
+    int *calls = (int *)private_data;
+    int n;
+
+    n = __atomic_add_fetch(calls, 1, __ATOMIC_RELAXED);
+    // a handler stuck on a lock held by the program
+    while (__atomic_load_n(&sleepy_hold, __ATOMIC_RELAXED))
+        usleep(1000);
+    usleep(sleepy_us);
+    n = snprintf(buf->mem, buf->size, "calls %d\n", n);
+    *done = 1;
+    return n;
+}
+
+static void* stuck_reader(void *data) {
+    char mem[64];
+
+    ASSERT(uproc_read_entry((uproc_dentry_t *)data, mem, sizeof(mem)) > 0);
+    return NULL;
+}
+
+void test_uproc_budget() {
+    uproc_ctx_t uproc_ctx;
+    uproc_dentry_t *logged, *eagain, *stale, *ent;
+    int nlogged = 0, neagain = 0, nstale = 0, ret, i;
+    pthread_t tid, tids[4];
+    char mem[64];
+
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    logged = uproc_create_entry(&uproc_ctx, "logged", 0, 64, NULL, sleepy_read_proc, NULL, &nlogged);
+    eagain = uproc_create_entry(&uproc_ctx, "eagain", 0, 64, NULL, sleepy_read_proc, NULL, &neagain);
+    stale = uproc_create_entry(&uproc_ctx, "stale", 0, 64, NULL, sleepy_read_proc, NULL, &nstale);
+    ASSERT(logged && eagain && stale);
+    ASSERT(!uproc_entry_set_budget(logged, 2, UPROC_BUDGET_LOG));
+    ASSERT(!uproc_entry_set_budget(eagain, 2, UPROC_BUDGET_EAGAIN));
+    ASSERT(!uproc_entry_set_budget(stale, 2, UPROC_BUDGET_STALE));
+    ASSERT(uproc_entry_set_budget(stale, 2, 7) == -EINVAL);
+    ASSERT(uproc_entry_set_budget(uproc_ctx.root, 2, UPROC_BUDGET_LOG) == -EINVAL);
+
+    ASSERT(uproc_read_entry(stale, mem, sizeof(mem)) == strlen("calls 1\n"));
+    sleepy_us = 10 * 1000;
+    for (i = 0; i < 3; ++i) {
+        ASSERT(uproc_read_entry(logged, mem, sizeof(mem)) > 0);
+        ASSERT(uproc_read_entry(eagain, mem, sizeof(mem)) > 0);
+        ASSERT(uproc_read_entry(stale, mem, sizeof(mem)) > 0);
+    }
+    ASSERT(uproc_entry_slow_calls(logged) == 3);
+    ASSERT(uproc_entry_slow_calls(eagain) == 3);
+    ASSERT(uproc_entry_slow_calls(stale) == 3);
+
+    // repeat offenders are short-circuited, unless they are only logged
+    ASSERT(uproc_read_entry(logged, mem, sizeof(mem)) > 0);
+    ASSERT(nlogged == 4);
+    ASSERT(uproc_read_entry(eagain, mem, sizeof(mem)) == -EAGAIN);
+    ASSERT(neagain == 3);
+    ASSERT(uproc_read_entry(stale, mem, sizeof(mem)) == strlen("calls 4\n"));
+    ASSERT(!memcmp(mem, "calls 4\n", strlen("calls 4\n")));
+    ASSERT(nstale == 4);
+
+    // a call stuck over budget doesn't hold up the other readers
+    ASSERT(!uproc_entry_set_budget(eagain, 0, UPROC_BUDGET_LOG));
+    ASSERT(!uproc_entry_set_budget(eagain, 5, UPROC_BUDGET_EAGAIN));
+    sleepy_us = 0;
+    __atomic_store_n(&sleepy_hold, 1, __ATOMIC_RELAXED);
+    ASSERT(!pthread_create(&tid, NULL, stuck_reader, eagain));
+    usleep(30 * 1000);
+    ASSERT(uproc_read_entry(eagain, mem, sizeof(mem)) == -EAGAIN);
+    __atomic_store_n(&sleepy_hold, 0, __ATOMIC_RELAXED);
+    pthread_join(tid, NULL);
+    ASSERT(uproc_read_entry(eagain, mem, sizeof(mem)) > 0);
+
+    // overlapping calls of a healthy handler are never short-circuited,
+    // not even while its budget is changed or removed
+    ent = uproc_create_entry(&uproc_ctx, "healthy", 0, 64, NULL, fixed_read_proc, NULL, NULL);
+    ASSERT(ent);
+    toggle_stop = 0;
+    for (i = 0; i < 4; ++i)
+        ASSERT(!pthread_create(&tids[i], NULL, toggle_reader, ent));
+    for (i = 0; i < 3000; ++i) {
+        ASSERT(!uproc_entry_set_budget(ent, i % 3 ? 1000 : 0,
+                                       i % 3 == 1 ? UPROC_BUDGET_EAGAIN : UPROC_BUDGET_STALE));
+    }
+    __atomic_store_n(&toggle_stop, 1, __ATOMIC_RELAXED);
+    for (i = 0; i < 4; ++i)
+        pthread_join(tids[i], NULL);
+    ASSERT(uproc_entry_slow_calls(ent) == 0);
+
+    uproc_destroy(&uproc_ctx);
+}
+
+static int burn_read_proc(uproc_buf_t *buf, int *done, off_t fileoff, void *private_data) {
+    struct timespec ts;
+    volatile uint64_t x = 0;
+
+    // spins for 2ms of CPU time
+    do {
+        ++x;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    } while ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec < *(uint64_t *)private_data);
+    *done = 1;
+    return snprintf(buf->mem, buf->size, "burnt\n");
+}
+
+void test_uproc_stats() {
+    uproc_ctx_t uproc_ctx;
+    uproc_htable_stats_t hs;
+    uproc_dentry_t *dir, *ent, *burn;
+    struct timespec ts;
+    uint64_t until;
+    uproc_strbuf_t out;
+    int ret, i, v = 0;
+    char name[16];
+
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    dir = uproc_mkdir(&uproc_ctx, "dir", NULL);
+    for (i = 0; i < 100; ++i) {
+        snprintf(name, sizeof(name), "v%d", i);
+        ASSERT(uproc_create_entry_int(&uproc_ctx, name, 0, dir, 0, &v));
+    }
+    uproc_htable_stats(&uproc_ctx.htable, &hs);
+    ASSERT(hs.n_entries == 102);
+    ASSERT(hs.len > hs.n_entries && hs.used <= hs.n_entries);
+    ASSERT(hs.max_chain >= 1 && hs.load == (double)hs.n_entries / hs.len);
+
+    ASSERT(!uproc_enable_stats(&uproc_ctx));
+    ASSERT(uproc_enable_stats(&uproc_ctx) == -EEXIST);
+    ASSERT(uproc_ctx.stats);
+    ASSERT(uproc_lookup(&uproc_ctx, ".uproc/ops/read"));
+    ASSERT(uproc_lookup(&uproc_ctx, ".uproc/busy_ns"));
+
+    memset(&out, 0, sizeof(out));
+    ent = uproc_lookup(&uproc_ctx, ".uproc/dentries");
+    ASSERT(ent && !uproc_render_entry(ent, &out));
+    // the root, "dir" and its 100 entries, ".uproc" with "ops", 5 histograms and 7 files
+    ASSERT(!strncmp(out.data, "count 115\n", strlen("count 115\n")));
+    out.len = 0;
+    ent = uproc_lookup(&uproc_ctx, ".uproc/htable");
+    ASSERT(ent && !uproc_render_entry(ent, &out));
+    ASSERT(!strncmp(out.data, "buckets ", strlen("buckets ")));
+    uproc_strbuf_free(&out);
+
+    // uproc's own files are left out of bulk reads
+    ASSERT(uproc_create_entry_bulk(&uproc_ctx, NULL, NULL, UPROC_BULK_TEXT));
+    memset(&out, 0, sizeof(out));
+    ASSERT(!uproc_render_entry(find_child(uproc_ctx.root, UPROC_BULK_TEXT_NAME), &out));
+    ASSERT(!uproc_strbuf_append(&out, "", 1));
+    ASSERT(!strstr(out.data, ".uproc"));
+    uproc_strbuf_free(&out);
+
+    // handlers are accounted by entry, the most expensive ones make the top file
+    ASSERT(uproc_lookup(&uproc_ctx, "dir/v0")->cost);
+    burn = uproc_create_entry(&uproc_ctx, "burn", 0, 64, NULL, burn_read_proc, NULL, &until);
+    ASSERT(burn && burn->cost);
+    for (i = 0; i < 3; ++i) {
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        until = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec + 2000000;
+        ASSERT(uproc_read_entry(burn, name, sizeof(name)) == 6);
+        ASSERT(uproc_read_entry(uproc_lookup(&uproc_ctx, "dir/v1"), name, sizeof(name)) == 2);
+    }
+    ASSERT(burn->cost->reads == 3 && burn->cost->bytes == 18);
+    ASSERT(burn->cost->cpu_ns >= 6000000 && burn->cost->max_ns >= 2000000);
+    memset(&out, 0, sizeof(out));
+    ent = uproc_lookup(&uproc_ctx, ".uproc/top");
+    ASSERT(ent && !uproc_render_entry(ent, &out));
+    ASSERT(!strncmp(out.data, "/burn cpu_ns ", strlen("/burn cpu_ns ")));
+    ASSERT(!uproc_strbuf_append(&out, "", 1));
+    ASSERT(strstr(out.data, "\n/dir/v1 cpu_ns "));
+    uproc_strbuf_free(&out);
+
+    uproc_destroy(&uproc_ctx);
+    ASSERT(!uproc_ctx.stats);
+
+    // a name clash is refused before anything is made
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    ASSERT(uproc_mkdir(&uproc_ctx, ".uproc", NULL));
+    ASSERT(uproc_enable_stats(&uproc_ctx) == -EEXIST);
+    ASSERT(!uproc_ctx.stats && !uproc_lookup(&uproc_ctx, ".uproc/ops"));
+    uproc_destroy(&uproc_ctx);
+}
+
+#define REGISTER_THREADS 4
+#define REGISTER_ENTRIES 2000
+static uproc_ctx_t register_ctx;
+static int register_done, register_value;
+
+static void* register_thread(void *data) {
+    uproc_dentry_t *dir;
+    char name[16];
+    int i;
+
+    snprintf(name, sizeof(name), "t%d", (int)(intptr_t)data);
+    dir = uproc_mkdir(&register_ctx, name, NULL);
+    ASSERT(dir);
+    for (i = 0; i < REGISTER_ENTRIES; ++i) {
+        snprintf(name, sizeof(name), "e%d", i);
+        ASSERT(uproc_create_entry_int(&register_ctx, name, 0, dir, 1, &register_value));
+    }
+    return NULL;
+}
+
+static void* lookup_thread(void *data) {
+    unsigned long found = 0;
+    char path[32];
+    int i = 0;
+
+    while (!__atomic_load_n(&register_done, __ATOMIC_RELAXED)) {
+        snprintf(path, sizeof(path), "t%d/e%d", i % REGISTER_THREADS, i % REGISTER_ENTRIES);
+        found += !!uproc_lookup(&register_ctx, path);
+        ASSERT(uproc_lookup(&register_ctx, "stable"));
+        ++i;
+    }
+    return (void*)found;
+}
+
+void test_uproc_concurrent_register() {
+    pthread_t creators[REGISTER_THREADS], readers[2];
+    char path[32];
+    int i, j;
+
+    ASSERT(!uproc_ctx_init(&register_ctx, "uproc", 0));
+    ASSERT(uproc_create_entry_int(&register_ctx, "stable", 0, NULL, 1, &register_value));
+
+    // entries are registered while others are looked up, the hash table grows meanwhile
+    for (i = 0; i < 2; ++i)
+        ASSERT(!pthread_create(&readers[i], NULL, lookup_thread, NULL));
+    for (i = 0; i < REGISTER_THREADS; ++i)
+        ASSERT(!pthread_create(&creators[i], NULL, register_thread, (void*)(intptr_t)i));
+    for (i = 0; i < REGISTER_THREADS; ++i)
+        pthread_join(creators[i], NULL);
+    __atomic_store_n(&register_done, 1, __ATOMIC_RELAXED);
+    for (i = 0; i < 2; ++i)
+        pthread_join(readers[i], NULL);
+
+    ASSERT(register_ctx.htable.n_entries == 2 + REGISTER_THREADS * (REGISTER_ENTRIES + 1));
+    for (i = 0; i < REGISTER_THREADS; ++i) {
+        for (j = 0; j < REGISTER_ENTRIES; ++j) {
+            snprintf(path, sizeof(path), "t%d/e%d", i, j);
+            ASSERT(uproc_lookup(&register_ctx, path));
+        }
+    }
+    uproc_destroy(&register_ctx);
+}
+
+static void* walk_thread(void *data) {
+    const char *paths[] = { UPROC_BULK_TEXT_NAME, UPROC_METRICS_NAME, UPROC_STATS_NAME "/htable",
+                            UPROC_STATS_NAME "/dentries", UPROC_STATS_NAME "/top" };
+    uproc_strbuf_t out;
+    unsigned long n = 0;
+    size_t i;
+
+    memset(&out, 0, sizeof(out));
+    while (!__atomic_load_n(&register_done, __ATOMIC_RELAXED)) {
+        for (i = 0; i < sizeof(paths) / sizeof(paths[0]); ++i) {
+            out.len = 0;
+            ASSERT(!uproc_render_entry(uproc_lookup(&register_ctx, paths[i]), &out));
+        }
+        ASSERT(uproc_shm_sync(&register_ctx) >= 0);
+        ++n;
+    }
+    uproc_strbuf_free(&out);
+    return (void*)n;
+}
+
+void test_uproc_concurrent_walk() {
+    pthread_t creators[REGISTER_THREADS], walker;
+    char name[64];
+    int i;
+
+    snprintf(name, sizeof(name), "/uproc_test_walk.%d", (int)getpid());
+    ASSERT(!uproc_ctx_init(&register_ctx, "uproc", 0));
+    ASSERT(!uproc_enable_bulk(&register_ctx, UPROC_BULK_TEXT));
+    ASSERT(!uproc_enable_metrics(&register_ctx, "app"));
+    ASSERT(!uproc_enable_stats(&register_ctx));
+    ASSERT(!uproc_shm_open(&register_ctx, name, 64));
+
+    // the subtree files, metrics, stats and shm walk the tree while it grows
+    __atomic_store_n(&register_done, 0, __ATOMIC_RELAXED);
+    ASSERT(!pthread_create(&walker, NULL, walk_thread, NULL));
+    for (i = 0; i < REGISTER_THREADS; ++i)
+        ASSERT(!pthread_create(&creators[i], NULL, register_thread, (void*)(intptr_t)i));
+    for (i = 0; i < REGISTER_THREADS; ++i)
+        pthread_join(creators[i], NULL);
+    __atomic_store_n(&register_done, 1, __ATOMIC_RELAXED);
+    pthread_join(walker, NULL);
+
+    ASSERT(uproc_lookup(&register_ctx, "t0/e0"));
+    uproc_destroy(&register_ctx);
+}
+
 uproc_ctx_t global_ctx;
 void* uproc_thread(void*data) {
     // uproc_run() implies uproc_destroy()
@@ -64,6 +1329,7 @@ void* uproc_thread(void*data) {
 
 
 int global_var1 = 100;
+int global_var2;
 const char * global_const_str = "global_const_str";
 char global_str[100] = "global_str[100]";
 
@@ -100,11 +1366,137 @@ int write_str_to_file(const char *filename, char *buf, int size) {
     return nwritten;
 }
 
+static pthread_mutex_t apply_writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct test_stats *apply_stats;
+static uproc_seqlock_t *apply_seqlock;
+static int apply_stop;
+
+static void* apply_writer(void *data) {
+    uint64_t i;
+
+    for (i = 0; !__atomic_load_n(&apply_stop, __ATOMIC_RELAXED); ++i) {
+        pthread_mutex_lock(&apply_writer_lock);
+        uproc_write_seqbegin(apply_seqlock);
+        __atomic_store_n(&apply_stats->bytes, i, __ATOMIC_RELAXED);
+        apply_stats->load = i;
+        uproc_write_seqend(apply_seqlock);
+        pthread_mutex_unlock(&apply_writer_lock);
+    }
+    return NULL;
+}
+
+static void* apply_reader(void *data) {
+    uint64_t bytes;
+    double load;
+    unsigned seq;
+
+    while (!__atomic_load_n(&apply_stop, __ATOMIC_RELAXED)) {
+        do {
+            seq = uproc_read_seqbegin(apply_seqlock);
+            bytes = __atomic_load_n(&apply_stats->bytes, __ATOMIC_RELAXED);
+            load = apply_stats->load;
+        } while (uproc_read_seqretry(apply_seqlock, seq));
+        ASSERT((double)bytes == load);
+    }
+    return NULL;
+}
+
+void test_uproc_apply() {
+    pthread_t writer, reader;
+    uproc_ctx_t uproc_ctx;
+    uproc_strbuf_t status;
+    uproc_dentry_t *conf, *limits, *ent;
+    uproc_seqlock_t sl = UPROC_SEQLOCK_INIT;
+    uproc_buf_t b;
+    int i, ret, mtu = 1500, ro = 1;
+    char name[16] = "eth0";
+    struct test_stats st = {1024, 8, -1, 0.5};
+    uproc_field_t fields[] = {
+        UPROC_FIELD(UPROC_TYPE_UINT64, struct test_stats, bytes),
+        UPROC_FIELD(UPROC_TYPE_DOUBLE, struct test_stats, load),
+    };
+    const char *batch = "# rollout\nmtu 9000\n\n  limits/bytes   2048 \nname lo0\nlimits/load 0.25\n";
+    const char *bad = "mtu 1280\nlimits/bytes 4096\nlimits/load x\n";
+
+    ret = uproc_ctx_init(&uproc_ctx, "uproc", 1);
+    ASSERT(!ret);
+    conf = uproc_mkdir(&uproc_ctx, "conf", NULL);
+    ASSERT(conf);
+    ASSERT(uproc_create_entry_int(&uproc_ctx, "mtu", 0, conf, 0, &mtu));
+    ASSERT(uproc_create_entry_int(&uproc_ctx, "ro", 0, conf, 1, &ro));
+    ASSERT(uproc_create_entry_string(&uproc_ctx, "name", 0, conf, sizeof(name), 0, name));
+    limits = uproc_mkdir_struct(&uproc_ctx, "conf/limits", 0, NULL, 0, &st, fields, 2);
+    ASSERT(limits);
+    uproc_entry_set_seqlock(limits, &sl);
+    ent = uproc_create_entry_apply(&uproc_ctx, NULL, conf);
+    ASSERT(ent && ent->flags & UPROC_DENTRY_ASSEMBLE);
+    ASSERT(uproc_lookup(&uproc_ctx, "conf/" UPROC_APPLY_NAME) == ent);
+
+    // the group is only written along with the program's writers if they declared their lock
+    ASSERT(uproc_apply(&uproc_ctx, conf, batch, strlen(batch), NULL) == -ENOLCK);
+    ASSERT(mtu == 1500 && sl.seq == 0);
+    uproc_entry_set_writer_lock(limits, &apply_writer_lock);
+    ASSERT(uproc_entry_writer_lock(uproc_lookup(&uproc_ctx, "conf/limits/load")) == &apply_writer_lock);
+
+    memset(&status, 0, sizeof(status));
+    ASSERT(!uproc_apply(&uproc_ctx, conf, batch, strlen(batch), &status));
+    ASSERT(status.len == 10 && !memcmp(status.data, "applied 4\n", 10));
+    ASSERT(mtu == 9000 && st.bytes == 2048 && st.load == 0.25 && !strcmp(name, "lo0"));
+    // the batch was stored within one write section
+    ASSERT(sl.seq == 2);
+
+    // a refused value leaves every entry as it was
+    status.len = 0;
+    ASSERT(uproc_apply(&uproc_ctx, conf, bad, strlen(bad), &status) == -EINVAL);
+    ASSERT(!strncmp(status.data, "line 3: limits/load: ", 21));
+    ASSERT(mtu == 9000 && st.bytes == 2048 && sl.seq == 2);
+    ASSERT(uproc_apply(&uproc_ctx, conf, "nope 1", 6, NULL) == -ENOENT);
+    ASSERT(uproc_apply(&uproc_ctx, conf, "ro 2", 4, NULL) == -EACCES);
+    ASSERT(uproc_apply(&uproc_ctx, conf, ".apply 2", 8, NULL) == -EOPNOTSUPP);
+    ASSERT(uproc_apply(&uproc_ctx, conf, "limits 2", 8, NULL) == -EISDIR);
+    ASSERT(uproc_apply(&uproc_ctx, conf, "", 0, NULL) == 0);
+    ASSERT(ro == 1);
+
+    // the control file applies a batch as a whole, the status is read back
+    memset(&b, 0, sizeof(b));
+    b.entry = ent;
+    b.mem = "mtu 1280\n";
+    b.size = strlen(b.mem);
+    ASSERT(ent->write_proc(&b, &b.done, 0, ent->private_data) == b.size);
+    ASSERT(mtu == 1280);
+    status.len = 0;
+    ASSERT(!uproc_render_entry(ent, &status));
+    ASSERT(status.len == 10 && !memcmp(status.data, "applied 1\n", 10));
+    b.mem = "mtu 1\nnope 2\n";
+    b.size = strlen(b.mem);
+    ASSERT(ent->write_proc(&b, &b.done, 0, ent->private_data) == -ENOENT);
+    ASSERT(mtu == 1280);
+    status.len = 0;
+    ASSERT(!uproc_render_entry(ent, &status));
+    ASSERT(!uproc_strbuf_append(&status, "", 1));
+    ASSERT(!strcmp(status.data, "line 2: nope: No such file or directory\n"));
+    uproc_strbuf_free(&status);
+
+    // batches and the program's writers both keep bytes == load, readers never see them apart
+    apply_stats = &st;
+    apply_seqlock = &sl;
+    apply_stop = 0;
+    ASSERT(!pthread_create(&writer, NULL, apply_writer, NULL));
+    ASSERT(!pthread_create(&reader, NULL, apply_reader, NULL));
+    for (i = 0; i < 2000; ++i)
+        ASSERT(!uproc_apply(&uproc_ctx, conf, "limits/bytes 7\nlimits/load 7\n", 28, NULL));
+    __atomic_store_n(&apply_stop, 1, __ATOMIC_RELAXED);
+    pthread_join(writer, NULL);
+    pthread_join(reader, NULL);
+
+    uproc_destroy(&uproc_ctx);
+}
+
 void test_uproc_general() {
-    int ret, n, x;
+    int ret, n, x, fd;
     char buf[1024];
     pthread_t tid;
-    uproc_dentry_t *ent1, *ent2, *ent3;
+    uproc_dentry_t *ent1, *ent2, *ent3, *ent4;
 
     ret = uproc_ctx_init(&global_ctx, "uproc", 1);
 
@@ -129,6 +1521,8 @@ void test_uproc_general() {
                           /* readonly ? */ 0,
                           /* pointer to the variable */ global_str);
     ASSERT(ent3);
+    ent4 = uproc_create_entry_int(&global_ctx, "global_var2", S_IRUSR | S_IWUSR, NULL, 0, &global_var2);
+    ASSERT(ent4 && !uproc_entry_set_assembled(ent4));
 
     if (pthread_create(&tid, NULL, uproc_thread, NULL)) {
         exit(1);
@@ -187,6 +1581,23 @@ void test_uproc_general() {
         ASSERT(strcmp(buf, "new_string"));
     }
 
+    { //test case for global_var2, assembled from two writes
+        fd = open("uproc/global_var2", O_WRONLY);
+        ASSERT(fd >= 0);
+        ASSERT(write(fd, "12", 2) == 2);
+        ASSERT(write(fd, "34\n", 3) == 3);
+        ASSERT(global_var2 == 0);
+        ASSERT(!close(fd));
+        ASSERT(global_var2 == 1234);
+
+        // a value the handler refuses fails the close
+        fd = open("uproc/global_var2", O_WRONLY);
+        ASSERT(fd >= 0);
+        ASSERT(write(fd, "abc", 3) == 3);
+        ASSERT(close(fd) && errno == EINVAL);
+        ASSERT(global_var2 == 1234);
+    }
+
     uproc_exit(&global_ctx);
     pthread_join(tid, NULL);
 }
@@ -194,6 +1605,27 @@ void test_uproc_general() {
 uproc_test_t tests[] = {
     {"test_uproc_ctx_init", test_uproc_ctx_init},
     {"test_uproc_create_entries", test_uproc_create_entries},
+    {"test_uproc_parse", test_uproc_parse},
+    {"test_uproc_counter", test_uproc_counter},
+    {"test_uproc_hist", test_uproc_hist},
+    {"test_uproc_rate", test_uproc_rate},
+    {"test_uproc_struct", test_uproc_struct},
+    {"test_uproc_seqlock", test_uproc_seqlock},
+    {"test_uproc_bulk", test_uproc_bulk},
+    {"test_uproc_query", test_uproc_query},
+    {"test_uproc_binary", test_uproc_binary},
+    {"test_uproc_shm", test_uproc_shm},
+    {"test_uproc_metrics", test_uproc_metrics},
+    {"test_uproc_cache", test_uproc_cache},
+    {"test_uproc_single_flight", test_uproc_single_flight},
+    {"test_uproc_publish", test_uproc_publish},
+    {"test_uproc_fmt_cache", test_uproc_fmt_cache},
+    {"test_uproc_async", test_uproc_async},
+    {"test_uproc_budget", test_uproc_budget},
+    {"test_uproc_stats", test_uproc_stats},
+    {"test_uproc_concurrent_register", test_uproc_concurrent_register},
+    {"test_uproc_concurrent_walk", test_uproc_concurrent_walk},
+    {"test_uproc_apply", test_uproc_apply},
     {"test_uproc_general", test_uproc_general},
     {"NULL", NULL}
 };